@@ -9,6 +9,8 @@
 
 #include "cppm_decoder.pio.h"
 
+class CPPMTrace;
+
 class CPPMDecoder {
  public:
   CPPMDecoder(uint cppm_gpio, PIO pio = pio0,
@@ -30,6 +32,10 @@ class CPPMDecoder {
   // dma_irq_index must be 0 or 1, corresponding to DMA_IRQ_0 or DMA_IRQ_1
   static void sharedInit(uint dma_irq_index);
 
+  // Record every frame (including frame errors) to trace, which must outlive this decoder.
+  // This must be called before startListening()
+  void setTrace(CPPMTrace* trace);
+
   // Start PIO/DMA, which will begin populating channel values continuously
   bool startListening();
 
@@ -82,6 +88,8 @@ class CPPMDecoder {
   // Channel period that maps to 1
   double calibrated_max_us;
 
+  CPPMTrace* trace = nullptr;
+
   bool is_calibrating = false;
   double calibrating_min_us;
   double calibrating_max_us;
@@ -0,0 +1,163 @@
+#ifndef __PICO_CPPM_CPPM_REFERENCE_H__
+#define __PICO_CPPM_CPPM_REFERENCE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hardware-independent equivalents of CPPMDecoder and CPPMEncoder, which operate on edge timestamps
+// instead of GPIOs. These do not depend on the Pico SDK, so they can also be built for a host machine
+// (e.g. to decode logic analyzer captures with the same rules as the hardware decoder).
+
+struct CPPMEdge {
+  uint64_t time_ns;
+  // GPIO level after the edge
+  bool level;
+};
+
+struct CPPMFrame {
+  static constexpr uint32_t NUM_CHANNELS = 10; // Must match cppm_decoder_NUM_CHANNELS
+
+  // Time at which the decoder DMA transfer would have finished for this frame
+  uint64_t time_ns;
+  // Number of decoded channels (non-zero values)
+  uint8_t channel_count;
+  // True if channel_count did not match the expected channel count
+  bool is_error;
+  // Raw values, as written to the CPPMDecoder DMA buffer (0 indicates no value)
+  uint32_t channels[NUM_CHANNELS];
+};
+
+class CPPMReferenceDecoder {
+ public:
+  static constexpr uint32_t NUM_CHANNELS = CPPMFrame::NUM_CHANNELS;
+  static constexpr uint32_t CLOCKS_PER_COUNT = 5; // Must match cppm_decoder_CLOCKS_PER_COUNT
+  static constexpr uint32_t DEFAULT_CLOCKS_PER_US = 125;
+  // Cycles of GPIO input synchronizer delay before the PIO sees a new level
+  static constexpr uint32_t INPUT_SYNC_CYCLES = 2;
+
+  CPPMReferenceDecoder(
+    uint8_t expected_channel_count = NUM_CHANNELS - 1, // Must be < NUM_CHANNELS
+    uint32_t max_period_us = 2500,
+    uint32_t clocks_per_us = DEFAULT_CLOCKS_PER_US);
+
+  // Equivalent of CPPMDecoder::startListening() at start_ns, with the GPIO at the given level
+  void reset(uint64_t start_ns = 0, bool level = true);
+
+  // Process a single edge, edges must be in time order. Returns true and populates frame if a frame
+  // finished (at most one frame can finish per edge).
+  //
+  // Edges are sampled on the same clock cycles as the decoder PIO program, so frames have the same raw
+  // counts and finish on the same cycle as with CPPMDecoder (edge times are rounded down to a clock cycle)
+  bool processEdge(const CPPMEdge& edge, CPPMFrame* frame);
+  // Process a batch of edges, writing finished frames to frames. Stops early if max_frames is reached,
+  // edges_processed is set to the number of edges consumed. Returns the number of frames written
+  size_t processEdges(const CPPMEdge* edges, size_t edge_count,
+    CPPMFrame* frames, size_t max_frames, size_t* edges_processed);
+  // Apply any timeout that occurs by time_ns without further edges (e.g. at the end of a capture).
+  // Returns true and populates frame if a frame finished
+  bool processTimeout(uint64_t time_ns, CPPMFrame* frame);
+
+  // Get the period for channel index ch of frame, in the same way as CPPMDecoder::getChannelUs()
+  double getChannelUs(const CPPMFrame& frame, uint32_t ch) const;
+
+  // Get cumulative frame error count (frames with unexpected number of channels)
+  uint32_t getFrameErrorCount() const { return frame_error_count; }
+
+ private:
+  static constexpr uint64_t NANOS_PER_MICRO = 1'000;
+
+  // Position in the decoder PIO program, which is always waiting to sample the pin
+  enum class State : uint8_t {
+    // wait_for_long_high: waiting for a HIGH period of at least max_period_us
+    SYNCING,
+    // ready_for_clean_frame: waiting for the first pulse edge of a frame
+    READY,
+    // wait_for_high: counting down during a pulse
+    WAIT_FOR_HIGH,
+    // wait_for_low: counting down until the next pulse edge
+    WAIT_FOR_LOW,
+  };
+
+  uint8_t expected_channel_count;
+  uint32_t clocks_per_us;
+  uint32_t max_period_count;
+
+  State state = State::SYNCING;
+  // Level seen by the PIO from next_sample_cycle until the next edge
+  bool level = true;
+  // Cycle on which the PIO next samples the pin, and its x register value at that sample
+  uint64_t next_sample_cycle = 0;
+  uint32_t x = 0;
+
+  // Number of values which can still be pushed in the current frame (the PIO y register)
+  uint32_t remaining_channels = 0;
+  uint32_t channels[NUM_CHANNELS] = {0};
+  uint32_t frame_error_count = 0;
+
+  uint64_t cyclesForNs(uint64_t ns) const { return ns * clocks_per_us / NANOS_PER_MICRO; }
+  uint64_t nsForCycles(uint64_t cycles) const { return cycles * NANOS_PER_MICRO / clocks_per_us; }
+  // Number of samples taken every period cycles from next_sample_cycle, before until_cycle
+  uint64_t samplesBefore(uint64_t until_cycle, uint32_t period) const {
+    return (until_cycle - next_sample_cycle + period - 1) / period;
+  }
+
+  // Run the PIO program for all samples before until_cycle (which all see the current level)
+  bool advance(uint64_t until_cycle, CPPMFrame* frame);
+  void startTimer(uint64_t mov_cycle);
+  // Pad the remaining channels with 0 from first_push_cycle, returns the number of channels padded
+  uint32_t flushChannels(uint64_t first_push_cycle, CPPMFrame* frame, bool* has_frame);
+  void finishFrame(uint64_t push_cycle, CPPMFrame* frame);
+};
+
+class CPPMReferenceEncoder {
+ public:
+  static constexpr uint32_t NUM_CHANNELS = 9; // Must match CPPMEncoder
+  static constexpr uint32_t CLOCKS_PER_COUNT = 2; // Must match cppm_encoder_CLOCKS_PER_COUNT
+  static constexpr uint32_t DEFAULT_CLOCKS_PER_US = 125;
+  // A falling and rising edge for each channel, plus the sync period
+  static constexpr size_t EDGES_PER_FRAME = 2 * (NUM_CHANNELS + 1);
+
+  CPPMReferenceEncoder(
+    double pulse_us = 500,
+    double min_channel_us = 1000,
+    double max_channel_us = 2000,
+    double sync_period_us = 5000,
+    uint32_t clocks_per_us = DEFAULT_CLOCKS_PER_US);
+
+  // Restart output at start_ns
+  void reset(uint64_t start_ns = 0);
+
+  // Set the value for channel index ch, in range [-1, 1]
+  void setChannelValue(uint32_t ch, double value);
+  // Set the period for channel index ch directly, without limiting it to [min_channel_us, max_channel_us]
+  // (e.g. to reproduce decoded periods). value_us must be longer than the pulse
+  void setChannelUs(uint32_t ch, double value_us);
+
+  // Write the edges for one full frame (EDGES_PER_FRAME entries) to edges, starting at the current
+  // time. Returns the number of edges written
+  size_t encodeFrame(CPPMEdge* edges);
+
+  // Time of the next frame's first edge
+  uint64_t getTimeNs() const;
+
+ private:
+  static constexpr uint64_t NANOS_PER_MICRO = 1'000;
+
+  double min_channel_us;
+  double max_channel_us;
+  uint32_t clocks_per_us;
+
+  uint32_t pulse_count;
+  // Leave room for one extra entry to store sync pulse
+  uint32_t channel_counts[NUM_CHANNELS + 1] = {0};
+
+  uint64_t start_ns = 0;
+  // Clocks elapsed since start_ns
+  uint64_t clocks = 0;
+
+  uint64_t nsForClocks(uint64_t clocks) const {
+    return start_ns + clocks * NANOS_PER_MICRO / clocks_per_us;
+  }
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __PICO_CPPM_CPPM_TRACE_H__
+#define __PICO_CPPM_CPPM_TRACE_H__
+
+#include <stdint.h>
+
+#include "hardware/uart.h"
+
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace_format.h"
+#include "pico_cppm/cppm_trace_ring.h"
+
+// Records every frame from a CPPMDecoder into a preallocated RAM ring (CPPMTraceRing), using the binary
+// format from cppm_trace_format.h. The ring can be read directly (e.g. to forward over USB), or streamed
+// to a UART via DMA. If the ring is full, new frames are dropped (and marked as such in the trace)
+class CPPMTrace {
+ public:
+  // buffer_size must be a power of 2, and at least CPPMTraceWriter::MAX_RECORD_SIZE
+  CPPMTrace(uint8_t* buffer, uint32_t buffer_size) : ring(buffer, buffer_size) {}
+  // TODO: cleanup in destructor
+
+  // Start a new trace, discarding any unread data (aborting any in-progress UART transfer). Called by
+  // CPPMDecoder::setTrace()
+  void begin(const CPPMTraceHeader& header);
+
+  // Append a record for frame. This is safe to call from an ISR, but must only be called from one
+  // context (i.e. a trace can only record one decoder)
+  void appendFrame(const CPPMFrame& frame) { ring.appendFrame(frame); }
+
+  // Get the number of bytes which have not yet been read or streamed
+  uint32_t getAvailable() { return ring.getAvailable(); }
+  // Copy up to size unread bytes to out, returns the number of bytes copied. Must not be used while
+  // streaming to a UART
+  uint32_t read(uint8_t* out, uint32_t size) { return ring.read(out, size); }
+
+  // Start streaming the trace to uart via DMA. service() must be called regularly to keep the stream going
+  bool startUARTStream(uart_inst_t* uart);
+  // Start a new DMA transfer of unread bytes, if the previous one has finished. Does not block
+  void service();
+
+  // Get cumulative count of frames which were dropped because the ring was full
+  uint32_t getDroppedFrameCount() { return ring.getDroppedFrameCount(); }
+
+ private:
+  CPPMTraceRing ring;
+
+  int dma_channel = -1;
+  // Size of the in-progress DMA transfer, to be consumed once it finishes
+  uint32_t dma_transfer_size = 0;
+};
+
+#endif
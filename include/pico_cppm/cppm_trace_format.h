@@ -0,0 +1,71 @@
+#ifndef __PICO_CPPM_CPPM_TRACE_FORMAT_H__
+#define __PICO_CPPM_CPPM_TRACE_FORMAT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico_cppm/cppm_reference.h"
+
+// Compact binary log of decoded frames. Like cppm_reference.h, this does not depend on the Pico SDK.
+//
+// A trace starts with a header:
+//   "cPPM", version byte, then varints expected_channel_count, max_period_us, clocks_per_us
+// Followed by one record per frame:
+//   flags byte: bits 0-3 channel_count, bit 4 is_error, bit 5 keyframe, bit 6 frames dropped before this one
+//   varint time: microseconds since the previous record, or absolute microseconds (mod 2^32) for keyframes
+//   channel_count zigzag varints: difference from the same channel of the previous record (mod 2^32),
+//     or from 0 for keyframes. Channels are contiguous from index 0, others are 0
+//
+// Varints are unsigned LEB128.
+
+struct CPPMTraceHeader {
+  uint8_t expected_channel_count;
+  uint32_t max_period_us;
+  uint32_t clocks_per_us;
+};
+
+class CPPMTraceWriter {
+ public:
+  static constexpr size_t MAX_HEADER_SIZE = 5 + 3 * 5;
+  static constexpr size_t MAX_RECORD_SIZE = 1 + 5 + CPPMFrame::NUM_CHANNELS * 5;
+
+  // Write header to out (at least MAX_HEADER_SIZE bytes), returns the number of bytes written.
+  // This also resets delta encoding, so the next frame is a keyframe
+  size_t writeHeader(const CPPMTraceHeader& header, uint8_t* out);
+  // Write a record for frame to out (at least MAX_RECORD_SIZE bytes), returns the number of bytes written
+  size_t writeFrame(const CPPMFrame& frame, uint8_t* out);
+  // Call if the latest record was discarded instead of stored. The next frame is written as a keyframe
+  // (so it does not depend on the discarded record), marked as following dropped frames
+  void dropFrame();
+
+ private:
+  bool next_keyframe = true;
+  bool frames_dropped = false;
+
+  uint32_t last_time_us = 0;
+  uint32_t last_channels[CPPMFrame::NUM_CHANNELS] = {0};
+};
+
+class CPPMTraceReader {
+ public:
+  enum class Result : uint8_t {
+    OK,
+    // More data is required to read a full header/record
+    INCOMPLETE,
+    INVALID,
+  };
+
+  // Read the header from data. On success, consumed is set to the number of bytes read
+  Result readHeader(const uint8_t* data, size_t size, size_t* consumed, CPPMTraceHeader* header);
+  // Read the next record from data. On success, consumed is set to the number of bytes read, and
+  // frames_dropped indicates whether frames were lost between the previous record and this one
+  Result readFrame(const uint8_t* data, size_t size, size_t* consumed, CPPMFrame* frame, bool* frames_dropped);
+
+ private:
+  bool has_time = false;
+  uint32_t last_time_us = 0;
+  uint64_t time_us = 0;
+  uint32_t last_channels[CPPMFrame::NUM_CHANNELS] = {0};
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __PICO_CPPM_CPPM_TRACE_RING_H__
+#define __PICO_CPPM_CPPM_TRACE_RING_H__
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace_format.h"
+
+// Single-producer, single-consumer ring of trace bytes in a preallocated buffer, used by CPPMTrace.
+// Like cppm_trace_format.h, this does not depend on the Pico SDK. If the ring is full, new frames are
+// dropped (and the next stored frame is marked as following dropped frames)
+class CPPMTraceRing {
+ public:
+  // buffer_size must be a power of 2, and at least CPPMTraceWriter::MAX_RECORD_SIZE
+  CPPMTraceRing(uint8_t* buffer, uint32_t buffer_size)
+    : buffer(buffer), buffer_mask(buffer_size - 1) {
+    assert(buffer_size >= CPPMTraceWriter::MAX_RECORD_SIZE);
+    assert(!(buffer_size & buffer_mask));
+  }
+
+  // Start a new trace, discarding any unread data. Must not be called concurrently with other methods
+  void begin(const CPPMTraceHeader& header);
+
+  // Append a record for frame. This is safe to call from an ISR, but must only be called from one
+  // context (the producer)
+  void appendFrame(const CPPMFrame& frame);
+
+  // Get the number of bytes which have not yet been consumed
+  uint32_t getAvailable() const { return head - tail; }
+  // Copy up to size unread bytes to out and consume them, returns the number of bytes copied
+  uint32_t read(uint8_t* out, uint32_t size);
+  // Point data at the unread bytes which are contiguous in the buffer (i.e. up to the end of the
+  // buffer), without consuming them. Returns the number of bytes
+  uint32_t peek(const uint8_t** data) const;
+  // Consume size bytes, which were previously returned by peek()
+  void consume(uint32_t size);
+
+  // Get cumulative count of frames which were dropped because the ring was full
+  uint32_t getDroppedFrameCount() const { return dropped_frame_count; }
+
+ private:
+  uint8_t* buffer;
+  uint32_t buffer_mask;
+
+  // Free-running byte positions, written by the producer (head) and consumer (tail) respectively
+  volatile uint32_t head = 0;
+  volatile uint32_t tail = 0;
+
+  CPPMTraceWriter writer;
+  volatile uint32_t dropped_frame_count = 0;
+
+  void appendBytes(const uint8_t* data, uint32_t size);
+};
+
+#endif
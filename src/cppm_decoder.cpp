@@ -11,8 +11,13 @@
 
 #include "pico_pio_loader/pico_pio_loader.h"
 
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace.h"
+
 #include "cppm_decoder.pio.h"
 
+static_assert(CPPMFrame::NUM_CHANNELS == cppm_decoder_NUM_CHANNELS);
+
 int CPPMDecoder::dma_irq_index = -1;
 CPPMDecoder* CPPMDecoder::dma_channel_to_instance[NUM_DMA_CHANNELS] = {0};
 
@@ -30,6 +35,15 @@ void CPPMDecoder::sharedInit(uint dma_irq_index) {
   irq_set_enabled(irq_num, true);
 }
 
+void CPPMDecoder::setTrace(CPPMTrace* trace) {
+  // Must be called before startListening()
+  assert(dma_channel < 0);
+
+  CPPMTraceHeader header = {expected_channel_count, max_period_us, clocks_per_us};
+  trace->begin(header);
+  this->trace = trace;
+}
+
 bool CPPMDecoder::startListening() {
   // Make sure we haven't already started
   if (dma_channel >= 0) {
@@ -182,16 +196,32 @@ void CPPMDecoder::handleDMAFinished() {
     }
   }
 
-  if (channel_count == expected_channel_count) {
+  uint64_t now_us = to_us_since_boot(get_absolute_time());
+  bool is_error = channel_count != expected_channel_count;
+  if (!is_error) {
     has_frame = true;
-    last_frame_us = to_us_since_boot(get_absolute_time());
+    last_frame_us = now_us;
     memcpy((void*)last_frame_channels, (void*)dma_buffer, sizeof(last_frame_channels));
   } else {
     frame_error_count++;
   }
 
+  // Copy the frame before the DMA buffer is reused
+  CPPMFrame frame;
+  if (trace) {
+    frame.time_ns = now_us * 1000;
+    frame.channel_count = channel_count;
+    frame.is_error = is_error;
+    memcpy(frame.channels, (void*)dma_buffer, sizeof(frame.channels));
+  }
+
   // Restart DMA transfer
   dma_channel_set_write_addr(dma_channel, dma_buffer, /*trigger=*/true);
+
+  // Encoding the trace record is slower, so do it after DMA is draining the PIO RX FIFO again
+  if (trace) {
+    trace->appendFrame(frame);
+  }
 }
 
 int CPPMDecoder::assignUnusedDMAChannelWithInterrupts(CPPMDecoder* instance) {
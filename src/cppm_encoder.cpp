@@ -69,11 +69,9 @@ bool CPPMEncoder::startPIO() {
     return false;
   }
 
-  cppm_encoder_program_init(pio, pio_sm, pio_offset, cppm_gpio);
-
-  // Unblock the PIO program by providing pulse duration via TX FIFO
+  // Pulse duration is loaded into the PIO program during init
   uint32_t pulse_count = pulse_us * clocks_per_us / cppm_encoder_CLOCKS_PER_COUNT;
-  pio_sm_put_blocking(pio, pio_sm, pulse_count);
+  cppm_encoder_program_init(pio, pio_sm, pio_offset, cppm_gpio, pulse_count);
   return true;
 }
 
@@ -0,0 +1,280 @@
+#include "pico_cppm/cppm_reference.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+// Cycle timing of cppm_decoder.pio, from a pin sample to the next sample of the same loop
+constexpr uint32_t READY_SAMPLE_CYCLES = 2;
+// wait_for_long_high restarts the timer (mov x, osr) after sampling LOW
+constexpr uint32_t SYNC_RESTART_CYCLES = 3;
+// Each padded channel is a jmp y--, in null, and jmp
+constexpr uint32_t FLUSH_CYCLES_PER_CHANNEL = 3;
+
+}  // namespace
+
+CPPMReferenceDecoder::CPPMReferenceDecoder(uint8_t expected_channel_count,
+  uint32_t max_period_us,
+  uint32_t clocks_per_us)
+  : expected_channel_count(expected_channel_count),
+  clocks_per_us(clocks_per_us) {
+  // Same integer math as CPPMDecoder::startListening()
+  max_period_count = max_period_us * clocks_per_us / CLOCKS_PER_COUNT;
+
+  reset();
+}
+
+void CPPMReferenceDecoder::reset(uint64_t start_ns, bool level) {
+  // PIO starts at flush_channels_and_sync with y = 0, so it has no channels to flush and goes straight
+  // to wait_for_long_high (set x, jmp y--, jmp !x, mov x, then jmp pin)
+  state = State::SYNCING;
+  this->level = level;
+  next_sample_cycle = cyclesForNs(start_ns) + 4;
+  x = max_period_count;
+  remaining_channels = 0;
+  memset(channels, 0, sizeof(channels));
+}
+
+bool CPPMReferenceDecoder::processEdge(const CPPMEdge& edge, CPPMFrame* frame) {
+  // Repeated levels are not edges
+  if (edge.level == level) {
+    return false;
+  }
+
+  // Samples before the input synchronizer passes the edge through still see the previous level
+  bool has_frame = advance(cyclesForNs(edge.time_ns) + INPUT_SYNC_CYCLES, frame);
+  level = edge.level;
+  return has_frame;
+}
+
+size_t CPPMReferenceDecoder::processEdges(const CPPMEdge* edges, size_t edge_count,
+  CPPMFrame* frames, size_t max_frames, size_t* edges_processed) {
+  size_t frame_count = 0;
+  size_t i = 0;
+  for (; i < edge_count && frame_count < max_frames; i++) {
+    if (processEdge(edges[i], &frames[frame_count])) {
+      frame_count++;
+    }
+  }
+
+  if (edges_processed) {
+    *edges_processed = i;
+  }
+  return frame_count;
+}
+
+bool CPPMReferenceDecoder::processTimeout(uint64_t time_ns, CPPMFrame* frame) {
+  return advance(cyclesForNs(time_ns), frame);
+}
+
+double CPPMReferenceDecoder::getChannelUs(const CPPMFrame& frame, uint32_t ch) const {
+  if (ch >= NUM_CHANNELS) {
+    return 0;
+  }
+  // 0 indicates that a channel value is not available
+  if (!frame.channels[ch]) {
+    return 0;
+  }
+
+  uint32_t last_count = max_period_count - frame.channels[ch];
+
+  return (last_count / (double)clocks_per_us) * CLOCKS_PER_COUNT;
+}
+
+bool CPPMReferenceDecoder::advance(uint64_t until_cycle, CPPMFrame* frame) {
+  // Runs of samples with the same result are skipped in one step. Instructions between samples do not
+  // depend on the pin, so they are applied together with the preceding sample (including padding
+  // channels, which may finish a frame shortly after until_cycle)
+  bool has_frame = false;
+  while (next_sample_cycle < until_cycle) {
+    uint64_t sample_cycle = next_sample_cycle;
+    switch (state) {
+      case State::SYNCING:
+        if (!level) {
+          // Any LOW sample restarts the timer
+          next_sample_cycle += SYNC_RESTART_CYCLES * samplesBefore(until_cycle, SYNC_RESTART_CYCLES);
+          x = max_period_count;
+        } else if (sample_cycle + (uint64_t)x * CLOCKS_PER_COUNT < until_cycle) {
+          // Sampled HIGH with x == 0, jmp x-- falls through to ready_for_clean_frame
+          next_sample_cycle += ((uint64_t)x + 1) * CLOCKS_PER_COUNT;
+          state = State::READY;
+        } else {
+          uint64_t samples = samplesBefore(until_cycle, CLOCKS_PER_COUNT);
+          x -= samples;
+          next_sample_cycle += samples * CLOCKS_PER_COUNT;
+        }
+        break;
+
+      case State::READY:
+        if (level) {
+          next_sample_cycle += READY_SAMPLE_CYCLES * samplesBefore(until_cycle, READY_SAMPLE_CYCLES);
+        } else {
+          // First pulse edge of a frame, no value (delay, set y, then mov x)
+          remaining_channels = NUM_CHANNELS;
+          startTimer(sample_cycle + 3);
+        }
+        break;
+
+      case State::WAIT_FOR_HIGH:
+        if (level) {
+          state = State::WAIT_FOR_LOW;
+          next_sample_cycle++;
+        } else if (sample_cycle + ((uint64_t)x - 1) * CLOCKS_PER_COUNT < until_cycle) {
+          // x reaches 0 after this many LOW samples: timeout during pulse, flush then re-sync (jmp x--,
+          // jmp !x, set x, jmp y-- then in null)
+          sample_cycle += ((uint64_t)x - 1) * CLOCKS_PER_COUNT;
+          uint32_t padded_count = flushChannels(sample_cycle + 7, frame, &has_frame);
+          // After padding: jmp y--, jmp !x, mov x, then jmp pin
+          state = State::SYNCING;
+          next_sample_cycle = sample_cycle + 9 + FLUSH_CYCLES_PER_CHANNEL * padded_count;
+          x = max_period_count;
+        } else {
+          uint64_t samples = samplesBefore(until_cycle, CLOCKS_PER_COUNT);
+          x -= samples;
+          next_sample_cycle += samples * CLOCKS_PER_COUNT;
+        }
+        break;
+
+      case State::WAIT_FOR_LOW:
+        if (!level) {
+          // Pulse edge (jmp !y with delay, then in x if there is room for another value)
+          if (!remaining_channels) {
+            startTimer(sample_cycle + 4);
+            break;
+          }
+          channels[NUM_CHANNELS - remaining_channels] = x;
+          remaining_channels--;
+          // DMA finishes as soon as the buffer is full, even if more pulses follow
+          if (!remaining_channels) {
+            finishFrame(sample_cycle + 4, frame);
+            has_frame = true;
+          }
+          startTimer(sample_cycle + 6);
+        } else if (sample_cycle + ((uint64_t)x - 1) * CLOCKS_PER_COUNT < until_cycle) {
+          // x reaches 0 after this many HIGH samples: timeout during sync period, flush then wait for the
+          // next frame (jmp x--, jmp !x, jmp y-- then in null)
+          sample_cycle += ((uint64_t)x - 1) * CLOCKS_PER_COUNT;
+          uint32_t padded_count = flushChannels(sample_cycle + 6, frame, &has_frame);
+          // After padding: jmp y--, jmp !x, then jmp pin
+          state = State::READY;
+          next_sample_cycle = sample_cycle + 7 + FLUSH_CYCLES_PER_CHANNEL * padded_count;
+        } else {
+          uint64_t samples = samplesBefore(until_cycle, CLOCKS_PER_COUNT);
+          x -= samples;
+          next_sample_cycle += samples * CLOCKS_PER_COUNT;
+        }
+        break;
+    }
+  }
+
+  return has_frame;
+}
+
+void CPPMReferenceDecoder::startTimer(uint64_t mov_cycle) {
+  // mov x, osr, then jmp !x before the first sample
+  state = State::WAIT_FOR_HIGH;
+  next_sample_cycle = mov_cycle + 2;
+  x = max_period_count;
+}
+
+uint32_t CPPMReferenceDecoder::flushChannels(uint64_t first_push_cycle, CPPMFrame* frame, bool* has_frame) {
+  // Nothing to flush if the DMA buffer was already filled (or no frame was started)
+  uint32_t padded_count = remaining_channels;
+  if (!padded_count) {
+    return 0;
+  }
+
+  // PIO pads the remaining channels with 0
+  while (remaining_channels) {
+    channels[NUM_CHANNELS - remaining_channels] = 0;
+    remaining_channels--;
+  }
+
+  finishFrame(first_push_cycle + FLUSH_CYCLES_PER_CHANNEL * (padded_count - 1), frame);
+  *has_frame = true;
+  return padded_count;
+}
+
+void CPPMReferenceDecoder::finishFrame(uint64_t push_cycle, CPPMFrame* frame) {
+  // Same validation as CPPMDecoder::handleDMAFinished()
+  uint8_t channel_count = 0;
+  for (uint32_t ch = 0; ch < NUM_CHANNELS; ch++) {
+    if (channels[ch]) {
+      channel_count++;
+    }
+  }
+
+  frame->time_ns = nsForCycles(push_cycle);
+  frame->channel_count = channel_count;
+  frame->is_error = channel_count != expected_channel_count;
+  memcpy(frame->channels, channels, sizeof(frame->channels));
+
+  if (frame->is_error) {
+    frame_error_count++;
+  }
+}
+
+CPPMReferenceEncoder::CPPMReferenceEncoder(double pulse_us,
+  double min_channel_us,
+  double max_channel_us,
+  double sync_period_us,
+  uint32_t clocks_per_us)
+  : min_channel_us(min_channel_us),
+  max_channel_us(max_channel_us),
+  clocks_per_us(clocks_per_us) {
+  // Same conversions as CPPMEncoder::startPIO() and CPPMEncoder::initDMABuffer()
+  pulse_count = pulse_us * clocks_per_us / CLOCKS_PER_COUNT;
+  for (uint32_t ch = 0; ch < NUM_CHANNELS; ch++) {
+    setChannelValue(ch, 0);
+  }
+  channel_counts[NUM_CHANNELS] = sync_period_us * clocks_per_us / CLOCKS_PER_COUNT;
+}
+
+void CPPMReferenceEncoder::reset(uint64_t start_ns) {
+  this->start_ns = start_ns;
+  clocks = 0;
+}
+
+void CPPMReferenceEncoder::setChannelValue(uint32_t ch, double value) {
+  if (ch >= NUM_CHANNELS) {
+    return;
+  }
+
+  // Convert to duration
+  double value_us = (value + 1) / 2 * (max_channel_us - min_channel_us) + min_channel_us;
+  if (value_us > max_channel_us) {
+    value_us = max_channel_us;
+  }
+  if (value_us < min_channel_us) {
+    value_us = min_channel_us;
+  }
+
+  setChannelUs(ch, value_us);
+}
+
+void CPPMReferenceEncoder::setChannelUs(uint32_t ch, double value_us) {
+  if (ch >= NUM_CHANNELS) {
+    return;
+  }
+
+  // Convert to loop count
+  channel_counts[ch] = value_us * clocks_per_us / CLOCKS_PER_COUNT;
+}
+
+size_t CPPMReferenceEncoder::encodeFrame(CPPMEdge* edges) {
+  size_t edge_count = 0;
+  for (uint32_t i = 0; i < NUM_CHANNELS + 1; i++) {
+    // Cycle timing of cppm_encoder.pio: the pulse lasts 2x+3 clocks, and the full period is 2y+7
+    // clocks (x is pulse count, y is channel count)
+    edges[edge_count++] = {nsForClocks(clocks), false};
+    edges[edge_count++] = {nsForClocks(clocks + 2 * (uint64_t)pulse_count + 3), true};
+    clocks += 2 * (uint64_t)channel_counts[i] + 7;
+  }
+  return edge_count;
+}
+
+uint64_t CPPMReferenceEncoder::getTimeNs() const {
+  return nsForClocks(clocks);
+}
@@ -0,0 +1,70 @@
+#include "pico_cppm/cppm_trace.h"
+
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/uart.h"
+
+#include "pico_cppm/cppm_trace_format.h"
+#include "pico_cppm/cppm_trace_ring.h"
+
+void CPPMTrace::begin(const CPPMTraceHeader& header) {
+  // Any in-progress UART transfer refers to discarded data, the stream continues from the new header
+  if (dma_channel >= 0) {
+    dma_channel_abort(dma_channel);
+  }
+  dma_transfer_size = 0;
+
+  ring.begin(header);
+}
+
+bool CPPMTrace::startUARTStream(uart_inst_t* uart) {
+  // Make sure we haven't already started
+  if (dma_channel >= 0) {
+    return false;
+  }
+
+  dma_channel = dma_claim_unused_channel(/*required=*/false);
+  if (dma_channel < 0) {
+    return false;
+  }
+
+  // This DMA channel will send contiguous ranges of the ring to the UART TX FIFO
+  dma_channel_config dma_config = dma_channel_get_default_config(dma_channel);
+  channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_8);
+  channel_config_set_read_increment(&dma_config, true);
+  channel_config_set_write_increment(&dma_config, false);
+  channel_config_set_dreq(&dma_config, uart_get_dreq(uart, /*is_tx=*/true));
+
+  dma_channel_configure(
+    dma_channel,
+    &dma_config,
+    &uart_get_hw(uart)->dr,
+    /*read_addr=*/nullptr, // Set by each transfer
+    /*transfer_count=*/0,
+    /*trigger=*/false);
+
+  service();
+  return true;
+}
+
+void CPPMTrace::service() {
+  if (dma_channel < 0 || dma_channel_is_busy(dma_channel)) {
+    return;
+  }
+
+  // Previous transfer has finished, so its bytes can be reused
+  ring.consume(dma_transfer_size);
+  dma_transfer_size = 0;
+
+  // Transfers stop at the end of the ring, the remainder will be sent by the next transfer
+  const uint8_t* data;
+  uint32_t size = ring.peek(&data);
+  if (!size) {
+    return;
+  }
+
+  dma_transfer_size = size;
+  dma_channel_transfer_from_buffer_now(dma_channel, data, size);
+}
@@ -0,0 +1,193 @@
+#include "pico_cppm/cppm_trace_format.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+constexpr uint8_t MAGIC[4] = {'c', 'P', 'P', 'M'};
+constexpr uint8_t VERSION = 1;
+
+constexpr uint8_t FLAG_CHANNEL_COUNT_MASK = 0x0f;
+constexpr uint8_t FLAG_ERROR = 1 << 4;
+constexpr uint8_t FLAG_KEYFRAME = 1 << 5;
+constexpr uint8_t FLAG_FRAMES_DROPPED = 1 << 6;
+
+constexpr uint64_t NANOS_PER_MICRO = 1'000;
+
+size_t writeVarint(uint32_t value, uint8_t* out) {
+  size_t size = 0;
+  while (value >= 0x80) {
+    out[size++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  out[size++] = value;
+  return size;
+}
+
+// Returns the number of bytes read, or 0 if data ends before the varint does (or it is too long)
+size_t readVarint(const uint8_t* data, size_t size, uint32_t* value) {
+  *value = 0;
+  for (size_t i = 0; i < size && i < 5; i++) {
+    *value |= (uint32_t)(data[i] & 0x7f) << (7 * i);
+    if (!(data[i] & 0x80)) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+uint32_t zigzag(uint32_t delta) {
+  return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+uint32_t unzigzag(uint32_t value) {
+  return (value >> 1) ^ -(value & 1);
+}
+
+}  // namespace
+
+size_t CPPMTraceWriter::writeHeader(const CPPMTraceHeader& header, uint8_t* out) {
+  next_keyframe = true;
+  frames_dropped = false;
+
+  size_t size = 0;
+  memcpy(out, MAGIC, sizeof(MAGIC));
+  size += sizeof(MAGIC);
+  out[size++] = VERSION;
+  size += writeVarint(header.expected_channel_count, &out[size]);
+  size += writeVarint(header.max_period_us, &out[size]);
+  size += writeVarint(header.clocks_per_us, &out[size]);
+  return size;
+}
+
+size_t CPPMTraceWriter::writeFrame(const CPPMFrame& frame, uint8_t* out) {
+  uint32_t time_us = frame.time_ns / NANOS_PER_MICRO;
+  uint8_t channel_count = frame.channel_count;
+  if (channel_count > CPPMFrame::NUM_CHANNELS) {
+    channel_count = CPPMFrame::NUM_CHANNELS;
+  }
+
+  uint8_t flags = channel_count;
+  if (frame.is_error) {
+    flags |= FLAG_ERROR;
+  }
+  if (next_keyframe) {
+    flags |= FLAG_KEYFRAME;
+    memset(last_channels, 0, sizeof(last_channels));
+  }
+  if (frames_dropped) {
+    flags |= FLAG_FRAMES_DROPPED;
+  }
+
+  size_t size = 0;
+  out[size++] = flags;
+  size += writeVarint(next_keyframe ? time_us : time_us - last_time_us, &out[size]);
+
+  for (uint32_t ch = 0; ch < CPPMFrame::NUM_CHANNELS; ch++) {
+    uint32_t value = ch < channel_count ? frame.channels[ch] : 0;
+    if (ch < channel_count) {
+      size += writeVarint(zigzag(value - last_channels[ch]), &out[size]);
+    }
+    last_channels[ch] = value;
+  }
+  last_time_us = time_us;
+
+  next_keyframe = false;
+  frames_dropped = false;
+  return size;
+}
+
+void CPPMTraceWriter::dropFrame() {
+  next_keyframe = true;
+  frames_dropped = true;
+}
+
+CPPMTraceReader::Result CPPMTraceReader::readHeader(const uint8_t* data, size_t size, size_t* consumed,
+  CPPMTraceHeader* header) {
+  size_t pos = 0;
+  for (uint8_t magic : MAGIC) {
+    if (pos >= size) {
+      return Result::INCOMPLETE;
+    }
+    if (data[pos++] != magic) {
+      return Result::INVALID;
+    }
+  }
+  if (pos >= size) {
+    return Result::INCOMPLETE;
+  }
+  if (data[pos++] != VERSION) {
+    return Result::INVALID;
+  }
+
+  uint32_t fields[3];
+  for (uint32_t& field : fields) {
+    size_t varint_size = readVarint(&data[pos], size - pos, &field);
+    if (!varint_size) {
+      return size - pos >= 5 ? Result::INVALID : Result::INCOMPLETE;
+    }
+    pos += varint_size;
+  }
+
+  header->expected_channel_count = fields[0];
+  header->max_period_us = fields[1];
+  header->clocks_per_us = fields[2];
+
+  has_time = false;
+  *consumed = pos;
+  return Result::OK;
+}
+
+CPPMTraceReader::Result CPPMTraceReader::readFrame(const uint8_t* data, size_t size, size_t* consumed,
+  CPPMFrame* frame, bool* frames_dropped) {
+  if (!size) {
+    return Result::INCOMPLETE;
+  }
+
+  size_t pos = 0;
+  uint8_t flags = data[pos++];
+  uint8_t channel_count = flags & FLAG_CHANNEL_COUNT_MASK;
+  if (channel_count > CPPMFrame::NUM_CHANNELS || (flags & 0x80)) {
+    return Result::INVALID;
+  }
+  bool is_keyframe = flags & FLAG_KEYFRAME;
+
+  // Decode into temporaries, so that an incomplete record can be retried with more data
+  uint32_t fields[1 + CPPMFrame::NUM_CHANNELS];
+  for (uint32_t i = 0; i < 1u + channel_count; i++) {
+    size_t varint_size = readVarint(&data[pos], size - pos, &fields[i]);
+    if (!varint_size) {
+      return size - pos >= 5 ? Result::INVALID : Result::INCOMPLETE;
+    }
+    pos += varint_size;
+  }
+
+  if (!is_keyframe && !has_time) {
+    // Delta-encoded record without a preceding keyframe
+    return Result::INVALID;
+  }
+
+  uint32_t record_time_us = is_keyframe ? fields[0] : last_time_us + fields[0];
+  if (has_time) {
+    time_us += record_time_us - last_time_us;
+  } else {
+    time_us = record_time_us;
+  }
+  has_time = true;
+  last_time_us = record_time_us;
+
+  for (uint32_t ch = 0; ch < CPPMFrame::NUM_CHANNELS; ch++) {
+    uint32_t base = is_keyframe ? 0 : last_channels[ch];
+    last_channels[ch] = ch < channel_count ? base + unzigzag(fields[1 + ch]) : 0;
+  }
+
+  frame->time_ns = time_us * NANOS_PER_MICRO;
+  frame->channel_count = channel_count;
+  frame->is_error = flags & FLAG_ERROR;
+  memcpy(frame->channels, last_channels, sizeof(frame->channels));
+  *frames_dropped = flags & FLAG_FRAMES_DROPPED;
+  *consumed = pos;
+  return Result::OK;
+}
@@ -0,0 +1,76 @@
+#include "pico_cppm/cppm_trace_ring.h"
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "pico_cppm/cppm_trace_format.h"
+
+void CPPMTraceRing::begin(const CPPMTraceHeader& header) {
+  head = 0;
+  tail = 0;
+  dropped_frame_count = 0;
+
+  uint8_t data[CPPMTraceWriter::MAX_HEADER_SIZE];
+  appendBytes(data, writer.writeHeader(header, data));
+}
+
+void CPPMTraceRing::appendFrame(const CPPMFrame& frame) {
+  uint8_t data[CPPMTraceWriter::MAX_RECORD_SIZE];
+  uint32_t size = writer.writeFrame(frame, data);
+
+  // Drop the frame rather than block or overwrite unread data
+  if (size > buffer_mask + 1 - getAvailable()) {
+    writer.dropFrame();
+    dropped_frame_count++;
+    return;
+  }
+
+  appendBytes(data, size);
+}
+
+uint32_t CPPMTraceRing::read(uint8_t* out, uint32_t size) {
+  uint32_t available = getAvailable();
+  if (size > available) {
+    size = available;
+  }
+
+  // Make sure bytes are not read before the producer has finished writing them
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  for (uint32_t i = 0; i < size; i++) {
+    out[i] = buffer[(tail + i) & buffer_mask];
+  }
+
+  consume(size);
+  return size;
+}
+
+uint32_t CPPMTraceRing::peek(const uint8_t** data) const {
+  // Stop at the end of the ring, the remainder starts at the beginning of the buffer
+  uint32_t offset = tail & buffer_mask;
+  uint32_t size = getAvailable();
+  if (size > buffer_mask + 1 - offset) {
+    size = buffer_mask + 1 - offset;
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  *data = &buffer[offset];
+  return size;
+}
+
+void CPPMTraceRing::consume(uint32_t size) {
+  // Make sure bytes have been read before the producer can reuse them
+  std::atomic_thread_fence(std::memory_order_release);
+  tail += size;
+}
+
+void CPPMTraceRing::appendBytes(const uint8_t* data, uint32_t size) {
+  for (uint32_t i = 0; i < size; i++) {
+    buffer[(head + i) & buffer_mask] = data[i];
+  }
+
+  // Make sure bytes are written before the consumer can see them
+  std::atomic_thread_fence(std::memory_order_release);
+  head += size;
+}
@@ -30,7 +30,8 @@ int main() {
   sleep_ms(2500);
   printf("Begin test\n");
 
-  CPPMEncoder encoder(TEST_GPIO_OUT, pio1, 500, MIN_PERIOD_US, MAX_PERIOD_US, 3000);
+  // Encoder and decoder programs share a single PIO block
+  CPPMEncoder encoder(TEST_GPIO_OUT, pio0, 500, MIN_PERIOD_US, MAX_PERIOD_US, 3000);
   CPPMDecoder decoder(TEST_GPIO_IN, pio0, 9, 2500, MIN_PERIOD_US, MAX_PERIOD_US);
   CPPMDecoder::sharedInit(0);
   decoder.startListening();
@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <chrono>
+#include <vector>
+
+#include "pico_cppm/cppm_reference.h"
+
+#include "cppm_decoder_pio_model.h"
+
+// Randomized and adversarial pulse trains, run through CPPMDecoderPIOModel (and CPPMReferenceDecoder).
+// Each trial is an adversarial segment followed by clean frames, which must be decoded correctly after
+// at most MAX_RESYNC_FRAMES. The model and reference decoder must produce identical frames (same raw
+// counts and finishing cycle) for every trial.
+//
+// Usage: cppm_decoder_fuzz_test [trials] [seed]
+
+constexpr uint32_t DEFAULT_TRIALS = 2000;
+constexpr uint64_t DEFAULT_SEED = 1;
+
+constexpr uint8_t EXPECTED_CHANNEL_COUNT = 9;
+constexpr uint32_t MAX_PERIOD_US = 2500;
+constexpr uint32_t CLOCKS_PER_US = 125;
+
+constexpr uint64_t NS_PER_CYCLE = 1000 / CLOCKS_PER_US;
+constexpr uint64_t NS_PER_COUNT = NS_PER_CYCLE * CPPMReferenceDecoder::CLOCKS_PER_COUNT;
+constexpr uint64_t MAX_PERIOD_NS = MAX_PERIOD_US * 1000;
+// Mild segments (and clean frame sync periods) keep durations at least this far from max period, so
+// they exercise ordinary channel and sync handling. Hostile segments target the timeout boundary itself
+constexpr uint64_t BOUNDARY_MARGIN_NS = 20'000;
+
+constexpr size_t CLEAN_FRAMES = 5;
+// Number of clean frames after an adversarial segment which may be lost or decoded incorrectly
+constexpr size_t MAX_RESYNC_FRAMES = 1;
+// Channel periods are arbitrary ns, so allow for sample phase as well as count quantization
+constexpr double EXPECT_DELTA_US = 0.2;
+
+constexpr int MAX_PRINTED_FAILURES = 20;
+
+int failure_count = 0;
+
+// Used for the same channel period conversion as CPPMDecoder
+const CPPMReferenceDecoder converter(EXPECTED_CHANNEL_COUNT, MAX_PERIOD_US, CLOCKS_PER_US);
+
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state(seed ? seed : 1) {}
+
+  uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+  // Uniform in [min, max]
+  uint64_t range(uint64_t min, uint64_t max) { return min + next() % (max - min + 1); }
+  // True with probability percent / 100
+  bool chance(uint32_t percent) { return next() % 100 < percent; }
+
+ private:
+  uint64_t state;
+};
+
+class PulseTrain {
+ public:
+  std::vector<CPPMEdge> edges;
+  uint64_t time_ns = 0;
+
+  // Falling edge, LOW for low_ns, then rising edge and HIGH for high_ns
+  void pulse(uint64_t low_ns, uint64_t high_ns) {
+    edges.push_back({time_ns, false});
+    time_ns += low_ns;
+    edges.push_back({time_ns, true});
+    time_ns += high_ns;
+  }
+};
+
+struct CleanFrame {
+  uint64_t start_ns;
+  uint64_t end_ns;
+  double channel_us[EXPECTED_CHANNEL_COUNT];
+};
+
+bool nearMaxPeriod(uint64_t ns) {
+  return ns + BOUNDARY_MARGIN_NS > MAX_PERIOD_NS && ns < MAX_PERIOD_NS + BOUNDARY_MARGIN_NS;
+}
+
+// Jittered channels, extreme pulse widths, long pulses, and sync periods, all well clear of max period.
+// These cover the decoder's normal paths far more often than noise from hostile segments would
+void addMildSegment(PulseTrain* train, Random* random) {
+  uint64_t event_count = random->range(5, 40);
+  for (uint64_t i = 0; i < event_count; i++) {
+    uint64_t choice = random->range(0, 99);
+    uint64_t low_ns;
+    uint64_t high_ns;
+    if (choice < 60) {
+      // Channel, with arbitrary pulse width and period
+      low_ns = random->range(200, 900'000);
+      high_ns = random->range(low_ns + 200, MAX_PERIOD_NS - BOUNDARY_MARGIN_NS) - low_ns;
+    } else if (choice < 70) {
+      // Extremely short pulse and period
+      low_ns = random->range(200, 2'000);
+      high_ns = random->range(200, 2'000);
+    } else if (choice < 80) {
+      // Pulse longer than max period
+      low_ns = random->range(MAX_PERIOD_NS + BOUNDARY_MARGIN_NS, 3 * MAX_PERIOD_NS);
+      high_ns = random->range(200, MAX_PERIOD_NS - BOUNDARY_MARGIN_NS);
+    } else if (choice < 95) {
+      // Sync period, which may or may not be long enough to re-sync after a long pulse
+      low_ns = random->range(200, 900'000);
+      high_ns = random->range(MAX_PERIOD_NS + BOUNDARY_MARGIN_NS - low_ns, 3 * MAX_PERIOD_NS);
+    } else {
+      low_ns = random->range(MAX_PERIOD_NS + BOUNDARY_MARGIN_NS, 3 * MAX_PERIOD_NS);
+      high_ns = random->range(MAX_PERIOD_NS + BOUNDARY_MARGIN_NS, 3 * MAX_PERIOD_NS);
+    }
+
+    if (nearMaxPeriod(low_ns) || nearMaxPeriod(high_ns) || nearMaxPeriod(low_ns + high_ns)) {
+      i--;
+      continue;
+    }
+    train->pulse(low_ns, high_ns);
+  }
+}
+
+// Runt pulses, burst noise, dropped edges, and durations right at max period
+void addHostileSegment(PulseTrain* train, Random* random) {
+  uint64_t event_count = random->range(5, 60);
+  for (uint64_t i = 0; i < event_count; i++) {
+    uint64_t choice = random->range(0, 99);
+    if (choice < 20) {
+      // Runt pulse, possibly shorter than the PIO sample period
+      train->pulse(random->range(1, 16) * NS_PER_CYCLE, random->range(NS_PER_CYCLE, 1'000'000));
+    } else if (choice < 35) {
+      // Burst noise
+      uint64_t toggle_count = random->range(10, 500);
+      for (uint64_t t = 0; t < toggle_count; t++) {
+        train->pulse(random->range(1, 100) * NS_PER_CYCLE, random->range(1, 100) * NS_PER_CYCLE);
+      }
+    } else if (choice < 55) {
+      // Frame with dropped edges, which merge neighbouring pulses or periods
+      uint64_t low_ns = 0;
+      uint64_t high_ns = 0;
+      for (uint32_t ch = 0; ch <= EXPECTED_CHANNEL_COUNT; ch++) {
+        low_ns += random->range(300'000, 500'000);
+        bool drop_rising = random->chance(15);
+        bool drop_falling = !drop_rising && random->chance(15);
+        if (drop_rising) {
+          // LOW continues through the next period
+          low_ns += random->range(500'000, 1'500'000);
+          continue;
+        }
+        high_ns += random->range(500'000, 1'500'000);
+        if (drop_falling) {
+          continue;
+        }
+        train->pulse(low_ns, high_ns);
+        low_ns = 0;
+        high_ns = 0;
+      }
+      if (low_ns) {
+        train->pulse(low_ns, high_ns + NS_PER_CYCLE);
+      }
+    } else if (choice < 75) {
+      // Period within a few counts of max period
+      uint64_t low_ns = random->range(200, 900'000);
+      uint64_t period_ns = MAX_PERIOD_NS - 5 * NS_PER_COUNT + random->range(0, 10) * NS_PER_COUNT;
+      train->pulse(low_ns, period_ns - low_ns);
+    } else if (choice < 85) {
+      // Pulse and HIGH period within a few counts of max period
+      uint64_t low_ns = MAX_PERIOD_NS - 5 * NS_PER_COUNT + random->range(0, 10) * NS_PER_COUNT;
+      uint64_t high_ns = MAX_PERIOD_NS - 5 * NS_PER_COUNT + random->range(0, 10) * NS_PER_COUNT;
+      train->pulse(low_ns, high_ns);
+    } else {
+      addMildSegment(train, random);
+    }
+  }
+}
+
+void addCleanFrames(PulseTrain* train, Random* random, std::vector<CleanFrame>* clean_frames) {
+  for (size_t f = 0; f < CLEAN_FRAMES; f++) {
+    CleanFrame frame;
+    frame.start_ns = train->time_ns;
+    uint64_t pulse_ns = random->range(300'000, 500'000);
+    for (uint32_t ch = 0; ch < EXPECTED_CHANNEL_COUNT; ch++) {
+      uint64_t period_ns = random->range(1'000'000, 2'000'000);
+      frame.channel_us[ch] = period_ns / 1000.0;
+      train->pulse(pulse_ns, period_ns - pulse_ns);
+    }
+    train->pulse(pulse_ns, random->range(MAX_PERIOD_NS + BOUNDARY_MARGIN_NS, MAX_PERIOD_NS + 5'000'000));
+    frame.end_ns = train->time_ns;
+    clean_frames->push_back(frame);
+  }
+}
+
+void fail(uint32_t trial, const char* decoder_name, const char* message, uint64_t time_ns) {
+  if (failure_count++ < MAX_PRINTED_FAILURES) {
+    printf("Failure in trial %u (%s): %s at %llu ns\n", trial, decoder_name, message, (unsigned long long)time_ns);
+  }
+}
+
+void checkInvariants(uint32_t trial, const char* decoder_name, const std::vector<CPPMFrame>& frames) {
+  uint64_t last_time_ns = 0;
+  for (const CPPMFrame& frame : frames) {
+    if (frame.time_ns < last_time_ns) {
+      fail(trial, decoder_name, "frame out of order", frame.time_ns);
+    }
+    last_time_ns = frame.time_ns;
+
+    // Values are contiguous from channel 0, and never exceed the max period count
+    uint32_t channel_count = 0;
+    for (uint32_t ch = 0; ch < CPPMFrame::NUM_CHANNELS; ch++) {
+      if (!frame.channels[ch]) {
+        continue;
+      }
+      if (ch != channel_count) {
+        fail(trial, decoder_name, "channels not contiguous", frame.time_ns);
+      }
+      if (converter.getChannelUs(frame, ch) > MAX_PERIOD_US) {
+        fail(trial, decoder_name, "channel longer than max period", frame.time_ns);
+      }
+      channel_count++;
+    }
+    if (frame.channel_count != channel_count) {
+      fail(trial, decoder_name, "wrong channel count", frame.time_ns);
+    }
+    if (frame.is_error != (channel_count != EXPECTED_CHANNEL_COUNT)) {
+      fail(trial, decoder_name, "wrong error flag", frame.time_ns);
+    }
+  }
+}
+
+void checkResync(uint32_t trial, const char* decoder_name, const std::vector<CPPMFrame>& frames,
+  const std::vector<CleanFrame>& clean_frames) {
+  size_t next_frame = 0;
+  for (size_t f = 0; f < clean_frames.size(); f++) {
+    const CleanFrame& clean_frame = clean_frames[f];
+
+    size_t frame_count = 0;
+    const CPPMFrame* frame = nullptr;
+    for (; next_frame < frames.size() && frames[next_frame].time_ns <= clean_frame.end_ns; next_frame++) {
+      if (frames[next_frame].time_ns > clean_frame.start_ns) {
+        frame = &frames[next_frame];
+        frame_count++;
+      }
+    }
+
+    if (f < MAX_RESYNC_FRAMES) {
+      continue;
+    }
+    if (frame_count != 1) {
+      fail(trial, decoder_name, "no single frame for clean frame after resync", clean_frame.start_ns);
+      continue;
+    }
+    if (frame->is_error) {
+      fail(trial, decoder_name, "error frame for clean frame after resync", clean_frame.start_ns);
+      continue;
+    }
+    for (uint32_t ch = 0; ch < EXPECTED_CHANNEL_COUNT; ch++) {
+      if (fabs(converter.getChannelUs(*frame, ch) - clean_frame.channel_us[ch]) > EXPECT_DELTA_US) {
+        fail(trial, decoder_name, "wrong channel value after resync", clean_frame.start_ns);
+        break;
+      }
+    }
+  }
+}
+
+void checkEquivalent(uint32_t trial, const std::vector<CPPMFrame>& model_frames,
+  const std::vector<CPPMFrame>& reference_frames) {
+  if (model_frames.size() != reference_frames.size()) {
+    fail(trial, "model vs reference", "different frame count", 0);
+    return;
+  }
+
+  for (size_t i = 0; i < model_frames.size(); i++) {
+    const CPPMFrame& model = model_frames[i];
+    const CPPMFrame& reference = reference_frames[i];
+    if (model.channel_count != reference.channel_count || model.is_error != reference.is_error) {
+      fail(trial, "model vs reference", "different frame", model.time_ns);
+      return;
+    }
+    if (model.time_ns != reference.time_ns) {
+      fail(trial, "model vs reference", "different frame time", model.time_ns);
+      return;
+    }
+    for (uint32_t ch = 0; ch < CPPMFrame::NUM_CHANNELS; ch++) {
+      if (model.channels[ch] != reference.channels[ch]) {
+        fail(trial, "model vs reference", "different channel value", model.time_ns);
+        return;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t trial_count = argc > 1 ? strtoul(argv[1], nullptr, 0) : DEFAULT_TRIALS;
+  uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 0) : DEFAULT_SEED;
+
+  printf("Begin test (%u trials, seed %llu)\n", trial_count, (unsigned long long)seed);
+
+  Random random(seed);
+  CPPMDecoderPIOModel model(EXPECTED_CHANNEL_COUNT, MAX_PERIOD_US, CLOCKS_PER_US);
+  if (!model.loadProgram(CPPM_DECODER_PIO_PATH)) {
+    printf("Failure: could not load decoder program\n");
+    return 1;
+  }
+  printf("Loaded %zu instructions from %s\n", model.getProgramSize(), CPPM_DECODER_PIO_PATH);
+
+  uint64_t model_frame_count = 0;
+  uint64_t reference_frame_count = 0;
+  uint64_t instruction_count = 0;
+  uint64_t simulated_ns = 0;
+  std::chrono::duration<double> model_seconds(0);
+  std::chrono::duration<double> reference_seconds(0);
+
+  std::vector<CPPMFrame> model_frames;
+  std::vector<CPPMFrame> reference_frames;
+  std::vector<CleanFrame> clean_frames;
+
+  for (uint32_t trial = 0; trial < trial_count; trial++) {
+    PulseTrain train;
+    clean_frames.clear();
+
+    // Half of the trials start with a mild segment, the rest with a hostile one
+    if (random.chance(50)) {
+      addMildSegment(&train, &random);
+    } else {
+      addHostileSegment(&train, &random);
+    }
+    // Random HIGH gap before the clean frames
+    train.time_ns += random.range(0, 3 * MAX_PERIOD_NS);
+    addCleanFrames(&train, &random, &clean_frames);
+    uint64_t end_ns = train.time_ns;
+
+    model_frames.clear();
+    auto model_start = std::chrono::steady_clock::now();
+    model.run(train.edges.data(), train.edges.size(), end_ns, &model_frames);
+    model_seconds += std::chrono::steady_clock::now() - model_start;
+
+    reference_frames.clear();
+    auto reference_start = std::chrono::steady_clock::now();
+    CPPMReferenceDecoder reference(EXPECTED_CHANNEL_COUNT, MAX_PERIOD_US, CLOCKS_PER_US);
+    CPPMFrame frame;
+    for (const CPPMEdge& edge : train.edges) {
+      if (reference.processEdge(edge, &frame)) {
+        reference_frames.push_back(frame);
+      }
+    }
+    if (reference.processTimeout(end_ns, &frame)) {
+      reference_frames.push_back(frame);
+    }
+    reference_seconds += std::chrono::steady_clock::now() - reference_start;
+
+    checkInvariants(trial, "model", model_frames);
+    checkInvariants(trial, "reference", reference_frames);
+    checkResync(trial, "model", model_frames, clean_frames);
+    checkResync(trial, "reference", reference_frames, clean_frames);
+    checkEquivalent(trial, model_frames, reference_frames);
+
+    model_frame_count += model_frames.size();
+    reference_frame_count += reference_frames.size();
+    instruction_count += model.getInstructionCount();
+    simulated_ns += end_ns;
+  }
+
+  printf("Model: %llu frames (%.1f s simulated, %llu instructions) in %.3f s, %.0f frames/s\n",
+    (unsigned long long)model_frame_count, simulated_ns / 1e9, (unsigned long long)instruction_count,
+    model_seconds.count(), model_frame_count / model_seconds.count());
+  printf("Reference: %llu frames in %.3f s, %.0f frames/s\n",
+    (unsigned long long)reference_frame_count, reference_seconds.count(),
+    reference_frame_count / reference_seconds.count());
+
+  if (failure_count) {
+    printf("%d failures\n", failure_count);
+  }
+  printf("Test complete!\n");
+  return failure_count ? 1 : 0;
+}
@@ -0,0 +1,432 @@
+#include "cppm_decoder_pio_model.h"
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t NUM_CHANNELS = CPPMFrame::NUM_CHANNELS;
+// PIO instruction memory size
+constexpr size_t MAX_PROGRAM_SIZE = 32;
+constexpr uint32_t MAX_DELAY = 31;
+constexpr size_t MAX_LINE_SIZE = 256;
+
+// Split line into tokens, without comments and commas. A trailing [delay] is returned separately
+std::vector<std::string> tokenize(const char* line, std::string* delay) {
+  std::string text(line);
+  size_t comment = std::min(text.find(';'), text.find("//"));
+  if (comment != std::string::npos) {
+    text.resize(comment);
+  }
+
+  delay->clear();
+  size_t delay_start = text.find('[');
+  if (delay_start != std::string::npos) {
+    size_t delay_end = text.find(']', delay_start);
+    *delay = text.substr(delay_start + 1, delay_end - delay_start - 1);
+    text.resize(delay_start);
+  }
+
+  std::vector<std::string> tokens;
+  std::string token;
+  for (char c : text) {
+    if (isspace((unsigned char)c) || c == ',') {
+      if (!token.empty()) {
+        tokens.push_back(token);
+        token.clear();
+      }
+    } else {
+      token += c;
+    }
+  }
+  if (!token.empty()) {
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+// Parse a number or the name of a .define
+bool parseValue(const std::string& token, const std::map<std::string, uint32_t>& defines, uint32_t* value) {
+  auto define = defines.find(token);
+  if (define != defines.end()) {
+    *value = define->second;
+    return true;
+  }
+
+  char* end;
+  *value = strtoul(token.c_str(), &end, 0);
+  return !token.empty() && !*end;
+}
+
+}  // namespace
+
+CPPMDecoderPIOModel::CPPMDecoderPIOModel(uint8_t expected_channel_count,
+  uint32_t max_period_us,
+  uint32_t clocks_per_us)
+  : expected_channel_count(expected_channel_count),
+  clocks_per_us(clocks_per_us) {
+  max_period_count = max_period_us * clocks_per_us / CPPMReferenceDecoder::CLOCKS_PER_COUNT;
+}
+
+bool CPPMDecoderPIOModel::loadProgram(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    printf("Could not open %s\n", path);
+    return false;
+  }
+
+  std::map<std::string, uint32_t> defines;
+  std::map<std::string, uint32_t> labels;
+  // Jump target names, resolved once all labels are known
+  std::vector<std::string> targets;
+  bool has_wrap = false;
+  bool in_c_sdk = false;
+
+  program.clear();
+  wrap_target = 0;
+
+  char line[MAX_LINE_SIZE];
+  bool ok = true;
+  for (uint32_t line_number = 1; ok && fgets(line, sizeof(line), file); line_number++) {
+    auto error = [&](const char* message) {
+      printf("%s:%u: %s\n", path, line_number, message);
+      ok = false;
+    };
+
+    // Code blocks for other languages are passed through by pioasm
+    if (in_c_sdk || line[0] == '%') {
+      in_c_sdk = strncmp(line, "%}", 2) != 0;
+      continue;
+    }
+
+    std::string delay;
+    std::vector<std::string> tokens = tokenize(line, &delay);
+    if (!tokens.empty() && tokens[0].back() == ':') {
+      tokens[0].pop_back();
+      labels[tokens[0]] = program.size();
+      tokens.erase(tokens.begin());
+    }
+    if (tokens.empty()) {
+      continue;
+    }
+
+    const std::string& op = tokens[0];
+    if (op[0] == '.') {
+      if (op == ".program") {
+        continue;
+      } else if (op == ".define") {
+        // .define [public] name value
+        size_t name_index = tokens.size() == 4 && tokens[1] == "public" ? 2 : 1;
+        uint32_t value;
+        if (tokens.size() != name_index + 2 || !parseValue(tokens[name_index + 1], defines, &value)) {
+          error("invalid .define");
+          continue;
+        }
+        defines[tokens[name_index]] = value;
+      } else if (op == ".wrap_target") {
+        wrap_target = program.size();
+      } else if (op == ".wrap") {
+        if (program.empty()) {
+          error(".wrap before any instructions");
+          continue;
+        }
+        wrap_source = program.size() - 1;
+        has_wrap = true;
+      } else {
+        error("unsupported directive");
+      }
+      continue;
+    }
+
+    Instruction instruction = {Op::JMP, Cond::ALWAYS, Reg::NONE, Reg::NONE, 0, 0, false};
+    if (!delay.empty() && (!parseValue(delay, defines, &instruction.delay) || instruction.delay > MAX_DELAY)) {
+      error("invalid delay");
+      continue;
+    }
+
+    auto parseRegister = [](const std::string& token, Reg* reg) {
+      if (token == "x") {
+        *reg = Reg::X;
+      } else if (token == "y") {
+        *reg = Reg::Y;
+      } else if (token == "osr") {
+        *reg = Reg::OSR;
+      } else if (token == "null") {
+        *reg = Reg::NONE;
+      } else {
+        return false;
+      }
+      return true;
+    };
+
+    std::string target;
+    if (op == "jmp" && (tokens.size() == 2 || tokens.size() == 3)) {
+      if (tokens.size() == 3) {
+        const std::string& cond = tokens[1];
+        if (cond == "!x") {
+          instruction.cond = Cond::NOT_X;
+        } else if (cond == "x--") {
+          instruction.cond = Cond::X_DEC;
+        } else if (cond == "!y") {
+          instruction.cond = Cond::NOT_Y;
+        } else if (cond == "y--") {
+          instruction.cond = Cond::Y_DEC;
+        } else if (cond == "pin") {
+          instruction.cond = Cond::PIN;
+          instruction.loop_head = true;
+        } else {
+          error("unsupported jmp condition");
+          continue;
+        }
+      }
+      target = tokens.back();
+    } else if (op == "mov" && tokens.size() == 3 &&
+      parseRegister(tokens[1], &instruction.dst) && instruction.dst != Reg::NONE &&
+      parseRegister(tokens[2], &instruction.src)) {
+      instruction.op = Op::MOV;
+    } else if (op == "set" && tokens.size() == 3 &&
+      parseRegister(tokens[1], &instruction.dst) && (instruction.dst == Reg::X || instruction.dst == Reg::Y) &&
+      parseValue(tokens[2], defines, &instruction.arg) && instruction.arg <= 31) {
+      instruction.op = Op::SET;
+    } else if (op == "in" && tokens.size() == 3 &&
+      parseRegister(tokens[1], &instruction.src) && instruction.src != Reg::OSR) {
+      // Each in must fill the ISR, since CPPMDecoder uses autopush with a threshold of 32 bits
+      uint32_t bit_count;
+      if (!parseValue(tokens[2], defines, &bit_count) || bit_count != 32) {
+        error("unsupported in bit count");
+        continue;
+      }
+      instruction.op = Op::IN;
+    } else {
+      error("unsupported instruction");
+      continue;
+    }
+
+    targets.push_back(target);
+    program.push_back(instruction);
+  }
+  fclose(file);
+
+  if (!ok) {
+    return false;
+  }
+  if (program.empty() || program.size() > MAX_PROGRAM_SIZE) {
+    printf("%s: program has %zu instructions\n", path, program.size());
+    return false;
+  }
+  if (!has_wrap) {
+    wrap_source = program.size() - 1;
+  }
+
+  for (size_t i = 0; i < program.size(); i++) {
+    if (program[i].op != Op::JMP) {
+      continue;
+    }
+    auto label = labels.find(targets[i]);
+    if (label != labels.end()) {
+      program[i].arg = label->second;
+    } else if (!parseValue(targets[i], defines, &program[i].arg) || program[i].arg >= program.size()) {
+      printf("%s: unknown jmp target %s\n", path, targets[i].c_str());
+      return false;
+    }
+  }
+
+  // The model, CPPMFrame and CPPMReferenceDecoder all rely on these
+  if (defines["NUM_CHANNELS"] != NUM_CHANNELS ||
+    defines["CLOCKS_PER_COUNT"] != CPPMReferenceDecoder::CLOCKS_PER_COUNT) {
+    printf("%s: NUM_CHANNELS or CLOCKS_PER_COUNT does not match cppm_reference.h\n", path);
+    return false;
+  }
+
+  return true;
+}
+
+void CPPMDecoderPIOModel::run(const CPPMEdge* edges, size_t edge_count, uint64_t end_ns,
+  std::vector<CPPMFrame>* frames) {
+  this->edges = edges;
+  this->edge_count = edge_count;
+  next_edge = 0;
+  level = true;
+
+  // Equivalent of cppm_decoder_program_init() and CPPMDecoder::startListening(), which start the
+  // program at its first instruction
+  pc = 0;
+  x = 0;
+  y = 0;
+  osr = max_period_count;
+  cycle = 0;
+  dma_count = 0;
+  push_count = 0;
+  instruction_count = 0;
+
+  uint64_t end_cycle = cyclesForNs(end_ns);
+
+  // State at the latest loop head, used to detect a loop iteration which can be repeated
+  bool has_probe = false;
+  uint32_t probe_pc = 0;
+  uint64_t probe_cycle = 0;
+  uint32_t probe_x = 0;
+  uint32_t probe_y = 0;
+  uint64_t probe_push_count = 0;
+  size_t probe_next_edge = 0;
+
+  while (!program.empty() && cycle < end_cycle) {
+    if (program[pc].loop_head) {
+      readPin();
+
+      // A full iteration ran with no pin change, no push and at most one x decrement. Repeat it for as
+      // long as the pin is unchanged and x stays >= 1 after each decrement (so every branch is the same)
+      if (has_probe && probe_pc == pc && probe_y == y && probe_push_count == push_count &&
+        probe_next_edge == next_edge) {
+        uint64_t iteration_cycles = cycle - probe_cycle;
+        uint32_t dx = probe_x - x;
+
+        uint64_t limit = std::min(nextLevelChangeCycle(), end_cycle);
+        uint64_t iterations = limit > cycle ? (limit - cycle) / iteration_cycles : 0;
+        if (dx == 1) {
+          iterations = std::min<uint64_t>(iterations, x >= 2 ? x - 1 : 0);
+        } else if (dx != 0) {
+          iterations = 0;
+        }
+
+        x -= iterations * dx;
+        cycle += iterations * iteration_cycles;
+      }
+
+      has_probe = true;
+      probe_pc = pc;
+      probe_cycle = cycle;
+      probe_x = x;
+      probe_y = y;
+      probe_push_count = push_count;
+      probe_next_edge = next_edge;
+    }
+
+    executeInstruction(frames);
+  }
+}
+
+uint64_t CPPMDecoderPIOModel::nextLevelChangeCycle() const {
+  if (next_edge >= edge_count) {
+    return UINT64_MAX;
+  }
+  return cyclesForNs(edges[next_edge].time_ns) + INPUT_SYNC_CYCLES;
+}
+
+bool CPPMDecoderPIOModel::readPin() {
+  while (next_edge < edge_count && nextLevelChangeCycle() <= cycle) {
+    level = edges[next_edge].level;
+    next_edge++;
+  }
+  return level;
+}
+
+uint32_t CPPMDecoderPIOModel::readRegister(Reg reg) const {
+  switch (reg) {
+    case Reg::X:
+      return x;
+    case Reg::Y:
+      return y;
+    case Reg::OSR:
+      return osr;
+    case Reg::NONE:
+      break;
+  }
+  return 0;
+}
+
+void CPPMDecoderPIOModel::writeRegister(Reg reg, uint32_t value) {
+  switch (reg) {
+    case Reg::X:
+      x = value;
+      break;
+    case Reg::Y:
+      y = value;
+      break;
+    case Reg::OSR:
+      osr = value;
+      break;
+    case Reg::NONE:
+      break;
+  }
+}
+
+void CPPMDecoderPIOModel::executeInstruction(std::vector<CPPMFrame>* frames) {
+  const Instruction& instruction = program[pc];
+  uint32_t next_pc = pc == wrap_source ? wrap_target : pc + 1;
+
+  switch (instruction.op) {
+    case Op::JMP: {
+      bool take = false;
+      switch (instruction.cond) {
+        case Cond::ALWAYS:
+          take = true;
+          break;
+        case Cond::NOT_X:
+          take = !x;
+          break;
+        case Cond::X_DEC:
+          take = x--;
+          break;
+        case Cond::NOT_Y:
+          take = !y;
+          break;
+        case Cond::Y_DEC:
+          take = y--;
+          break;
+        case Cond::PIN:
+          take = readPin();
+          break;
+      }
+      if (take) {
+        next_pc = instruction.arg;
+      }
+      break;
+    }
+    case Op::MOV:
+      writeRegister(instruction.dst, readRegister(instruction.src));
+      break;
+    case Op::SET:
+      writeRegister(instruction.dst, instruction.arg);
+      break;
+    case Op::IN:
+      push(readRegister(instruction.src), frames);
+      break;
+  }
+
+  pc = next_pc;
+  cycle += 1 + instruction.delay;
+  instruction_count++;
+}
+
+void CPPMDecoderPIOModel::push(uint32_t value, std::vector<CPPMFrame>* frames) {
+  // Autopush to the RX FIFO, which DMA drains into the CPPMDecoder buffer
+  dma_buffer[dma_count++] = value;
+  push_count++;
+  if (dma_count < NUM_CHANNELS) {
+    return;
+  }
+  dma_count = 0;
+
+  // Same validation as CPPMDecoder::handleDMAFinished()
+  CPPMFrame frame;
+  frame.time_ns = nsForCycles(cycle);
+  frame.channel_count = 0;
+  for (uint32_t ch = 0; ch < NUM_CHANNELS; ch++) {
+    if (dma_buffer[ch]) {
+      frame.channel_count++;
+    }
+  }
+  frame.is_error = frame.channel_count != expected_channel_count;
+  memcpy(frame.channels, dma_buffer, sizeof(frame.channels));
+  frames->push_back(frame);
+}
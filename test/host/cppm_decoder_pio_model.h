@@ -0,0 +1,116 @@
+#ifndef __PICO_CPPM_TEST_HOST_CPPM_DECODER_PIO_MODEL_H__
+#define __PICO_CPPM_TEST_HOST_CPPM_DECODER_PIO_MODEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "pico_cppm/cppm_reference.h"
+
+// Cycle-accurate host model of the decoder PIO program, plus the DMA transfer and frame validation done
+// by CPPMDecoder. The program is assembled from src/pio/cppm_decoder.pio itself (supporting only the
+// subset of PIO assembly used by the decoder), so the model always runs the current program.
+//
+// Counting loops are fast-forwarded: after one iteration of a loop is executed normally, any further
+// iterations which would sample the same pin level (and not reach x == 0) are skipped in one step.
+class CPPMDecoderPIOModel {
+ public:
+  static constexpr uint32_t INPUT_SYNC_CYCLES = CPPMReferenceDecoder::INPUT_SYNC_CYCLES;
+
+  CPPMDecoderPIOModel(
+    uint8_t expected_channel_count = CPPMFrame::NUM_CHANNELS - 1,
+    uint32_t max_period_us = 2500,
+    uint32_t clocks_per_us = CPPMReferenceDecoder::DEFAULT_CLOCKS_PER_US);
+
+  // Assemble the program from the .pio file at path. Returns false (after printing the reason) if the
+  // file can't be read, uses unsupported syntax, or its public defines don't match cppm_reference.h
+  bool loadProgram(const char* path);
+
+  // Run the program from startListening() at time 0 (with the GPIO HIGH) until end_ns, with GPIO input
+  // from edges (which must be in time order). Finished frames are appended to frames
+  void run(const CPPMEdge* edges, size_t edge_count, uint64_t end_ns, std::vector<CPPMFrame>* frames);
+
+  // Number of instructions in the loaded program
+  size_t getProgramSize() const { return program.size(); }
+  // Number of instructions executed (not including fast-forwarded loop iterations) by the latest run()
+  uint64_t getInstructionCount() const { return instruction_count; }
+
+ private:
+  enum class Op : uint8_t {
+    JMP,
+    MOV,
+    SET,
+    IN,
+  };
+
+  enum class Cond : uint8_t {
+    ALWAYS,
+    NOT_X,
+    X_DEC,
+    NOT_Y,
+    Y_DEC,
+    PIN,
+  };
+
+  enum class Reg : uint8_t {
+    X,
+    Y,
+    OSR,
+    NONE, // null
+  };
+
+  struct Instruction {
+    Op op;
+    Cond cond;
+    // Destination of mov/set, source of mov/in
+    Reg dst;
+    Reg src;
+    // Jump target, or value for set
+    uint32_t arg;
+    uint32_t delay;
+    // Pin test at the heart of a counting loop, where the loop may be fast-forwarded
+    bool loop_head;
+  };
+
+  uint8_t expected_channel_count;
+  uint32_t clocks_per_us;
+  uint32_t max_period_count;
+
+  std::vector<Instruction> program;
+  uint32_t wrap_target = 0;
+  uint32_t wrap_source = 0;
+
+  // Program state
+  uint32_t pc = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t osr = 0;
+  uint64_t cycle = 0;
+
+  // GPIO input state
+  const CPPMEdge* edges = nullptr;
+  size_t edge_count = 0;
+  size_t next_edge = 0;
+  bool level = true;
+
+  // DMA state
+  uint32_t dma_buffer[CPPMFrame::NUM_CHANNELS] = {0};
+  uint32_t dma_count = 0;
+  uint64_t push_count = 0;
+
+  uint64_t instruction_count = 0;
+
+  uint64_t cyclesForNs(uint64_t ns) const { return ns * clocks_per_us / 1000; }
+  uint64_t nsForCycles(uint64_t cycles) const { return cycles * 1000 / clocks_per_us; }
+
+  // First cycle at which the PIO may see a different GPIO level (UINT64_MAX if there are no more edges)
+  uint64_t nextLevelChangeCycle() const;
+  bool readPin();
+  uint32_t readRegister(Reg reg) const;
+  void writeRegister(Reg reg, uint32_t value);
+  void executeInstruction(std::vector<CPPMFrame>* frames);
+  void push(uint32_t value, std::vector<CPPMFrame>* frames);
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "pico_cppm/cppm_reference.h"
+
+// Mirrors test/cppm_decoder_test.cpp, with edges fed to CPPMReferenceDecoder instead of a GPIO
+constexpr uint32_t SYNC_PERIOD_US = 20000;
+constexpr uint32_t DEFAULT_PULSE_US = 500;
+constexpr double MIN_PERIOD_US = 1000;
+constexpr double MAX_PERIOD_US = 2000;
+constexpr double EXPECT_DELTA_US = 1;
+
+constexpr bool PULSE_GPIO_STATE = false;
+
+int failure_count = 0;
+
+CPPMReferenceDecoder decoder(9, SYNC_PERIOD_US);
+CPPMFrame last_frame = {};
+uint64_t now_ns = 0;
+
+void handleFrame(const CPPMFrame& frame) {
+  if (!frame.is_error) {
+    last_frame = frame;
+  }
+}
+
+void gpioPut(bool level) {
+  CPPMFrame frame;
+  if (decoder.processEdge({now_ns, level}, &frame)) {
+    handleFrame(frame);
+  }
+}
+
+void sleepUs(uint64_t us) {
+  now_ns += us * 1000;
+}
+
+double durationToUs(double duration) {
+  return (duration + 1) / 2 * (MAX_PERIOD_US - MIN_PERIOD_US) + MIN_PERIOD_US;
+}
+
+void sendSync(uint32_t pulse_us) {
+  gpioPut(PULSE_GPIO_STATE);
+  sleepUs(pulse_us);
+  gpioPut(!PULSE_GPIO_STATE);
+  sleepUs(SYNC_PERIOD_US - pulse_us);
+}
+
+void sendPulses(const double durations[], uint32_t pulse_us = 500, uint32_t num_channels = 9, bool with_sync = true) {
+  for (uint32_t i = 0; i < num_channels; i++) {
+    uint32_t channel_us = durationToUs(durations[i]);
+    gpioPut(PULSE_GPIO_STATE);
+    sleepUs(pulse_us);
+    gpioPut(!PULSE_GPIO_STATE);
+    if (channel_us > pulse_us) {
+      sleepUs(channel_us - pulse_us);
+    }
+  }
+  if (with_sync) {
+    sendSync(pulse_us);
+  }
+}
+
+void expectChannels(const double expected[], const char* test_name) {
+  // Apply any timeout which the hardware would have already seen
+  CPPMFrame frame;
+  if (decoder.processTimeout(now_ns, &frame)) {
+    handleFrame(frame);
+  }
+
+  for (int i = 0; i < 9; i++) {
+    double actual = decoder.getChannelUs(last_frame, i);
+    double want = expected[i] ? durationToUs(expected[i]) : 0;
+    if (fabs(actual - want) > EXPECT_DELTA_US) {
+      printf("Failure in \"%s\": expected %f; actual %f\n", test_name, want, actual);
+      failure_count++;
+    }
+  }
+}
+
+void expectErrorCount(uint32_t want) {
+  uint32_t error_count = decoder.getFrameErrorCount();
+  if (error_count != want) {
+    printf("Failure: got error_count %d; want %d\n", (int)error_count, (int)want);
+    failure_count++;
+  }
+}
+
+void testDecoder() {
+  gpioPut(!PULSE_GPIO_STATE);
+
+  sendPulses((const double[]){0.75, 0.75, 0.75, 0.75, 0.75, 0.75, 0.75, 0.75, 0.75});
+  sleepUs(1000);
+  expectChannels((const double[]){0, 0, 0, 0, 0, 0, 0, 0, 0}, "discard first frame");
+
+  sendPulses((const double[]){-1, 1, -1, 1, -1, 1, -1, 1, -1});
+  sleepUs(1000);
+  expectChannels((const double[]){-1, 1, -1, 1, -1, 1, -1, 1, -1}, "switching polarity");
+
+  sendPulses((const double[]){1, 1, -1, -1, 1, 1, -1, -1, 1}, DEFAULT_PULSE_US, 9, false);
+  gpioPut(PULSE_GPIO_STATE);
+  sleepUs(DEFAULT_PULSE_US);
+  gpioPut(!PULSE_GPIO_STATE);
+  sleepUs(SYNC_PERIOD_US * 10);
+  expectChannels((const double[]){1, 1, -1, -1, 1, 1, -1, -1, 1}, "long sync period");
+
+  sendPulses((const double[]){-1, 1, -1, 1, -1, 1, -1, 1, -1}, 950);
+  sleepUs(1000);
+  expectChannels((const double[]){-1, 1, -1, 1, -1, 1, -1, 1, -1}, "slow pulses");
+
+  sendPulses((const double[]){1, 1, -1, -1, 1, 1, -1, -1, 1}, 50);
+  sleepUs(1000);
+  expectChannels((const double[]){1, 1, -1, -1, 1, 1, -1, -1, 1}, "fast pulses");
+
+  sendPulses((const double[]){0.75, 0.75, 0.75}, DEFAULT_PULSE_US, 3);
+  sleepUs(1000);
+  expectChannels((const double[]){1, 1, -1, -1, 1, 1, -1, -1, 1}, "too few channels");
+  expectErrorCount(1);
+
+  sendPulses((const double[]){0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.75, 0.75, 0.75}, DEFAULT_PULSE_US, 12);
+  sleepUs(1000);
+  expectChannels((const double[]){1, 1, -1, -1, 1, 1, -1, -1, 1}, "too many channels");
+  expectErrorCount(2);
+
+  sendPulses((const double[]){0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25});
+  sleepUs(1000);
+  expectChannels((const double[]){0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25}, "recovery after too many channels");
+
+  sendPulses((const double[]){0.5}, SYNC_PERIOD_US + 1500, 1, false);
+  sendPulses((const double[]){0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5}, DEFAULT_PULSE_US, 8);
+  sleepUs(100000);
+  expectChannels((const double[]){0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25, 0.25}, "long pulse error");
+  expectErrorCount(3);
+
+  sendPulses((const double[]){0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5});
+  sleepUs(1000);
+  expectChannels((const double[]){0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5}, "recovery after error");
+
+  double expected[9];
+  for (float v = -1; v < 1; v += 0.05) {
+    for (int ch = 0; ch < 9; ch++) {
+      expected[ch] = v;
+    }
+    sendPulses(expected);
+    sleepUs(1000);
+    expectChannels(expected, "rapidly changing");
+  }
+}
+
+void testEncoderDecoder() {
+  constexpr size_t NUM_FRAMES = 8;
+  constexpr size_t MAX_FRAMES = 3;
+
+  CPPMReferenceEncoder encoder(500, MIN_PERIOD_US, MAX_PERIOD_US, 3000);
+  CPPMReferenceDecoder decoder(9, 2500);
+
+  const double values[9] = {-1.5, 1.5, -0.75, 0.75, -0.5, 0.5, -0.25, 0.25, 0};
+  for (uint32_t ch = 0; ch < 9; ch++) {
+    encoder.setChannelValue(ch, values[ch]);
+  }
+
+  CPPMEdge edges[NUM_FRAMES * CPPMReferenceEncoder::EDGES_PER_FRAME];
+  size_t edge_count = 0;
+  for (size_t i = 0; i < NUM_FRAMES; i++) {
+    edge_count += encoder.encodeFrame(&edges[edge_count]);
+  }
+
+  // Decode in small batches, to exercise stopping early when the frame buffer is full
+  CPPMFrame frames[MAX_FRAMES];
+  size_t total_frames = 0;
+  for (size_t i = 0; i < edge_count;) {
+    size_t edges_processed;
+    size_t frame_count = decoder.processEdges(&edges[i], edge_count - i, frames, MAX_FRAMES, &edges_processed);
+    i += edges_processed;
+
+    for (size_t f = 0; f < frame_count; f++) {
+      if (frames[f].is_error) {
+        printf("Failure in \"encoder decoder\": unexpected error frame\n");
+        failure_count++;
+      }
+      for (uint32_t ch = 0; ch < 9; ch++) {
+        double want = durationToUs(fmax(-1, fmin(1, values[ch])));
+        double actual = decoder.getChannelUs(frames[f], ch);
+        if (fabs(actual - want) > EXPECT_DELTA_US) {
+          printf("Failure in \"encoder decoder\": expected %f; actual %f\n", want, actual);
+          failure_count++;
+        }
+      }
+    }
+    total_frames += frame_count;
+  }
+  if (decoder.processTimeout(encoder.getTimeNs(), frames)) {
+    total_frames++;
+  }
+
+  // The first frame is discarded while syncing
+  if (total_frames != NUM_FRAMES - 1) {
+    printf("Failure in \"encoder decoder\": got %d frames; want %d\n", (int)total_frames, (int)NUM_FRAMES - 1);
+    failure_count++;
+  }
+}
+
+int main() {
+  printf("Begin test\n");
+
+  testDecoder();
+  testEncoderDecoder();
+
+  printf("Test complete!\n");
+  return failure_count ? 1 : 0;
+}
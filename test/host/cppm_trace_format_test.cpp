@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace_format.h"
+
+constexpr size_t NUM_FRAMES = 1000;
+constexpr CPPMTraceHeader HEADER = {9, 2500, 125};
+
+int failure_count = 0;
+
+uint32_t random_state = 1;
+
+uint32_t nextRandom() {
+  random_state = random_state * 1103515245 + 12345;
+  return random_state >> 8;
+}
+
+CPPMFrame makeFrame(size_t i) {
+  CPPMFrame frame = {};
+  // Occasional error frames with too few channels
+  frame.channel_count = (i % 50 == 7) ? 3 : 9;
+  frame.is_error = frame.channel_count != HEADER.expected_channel_count;
+  // Wrap the 32-bit microsecond timestamp part way through
+  frame.time_ns = (0xfff00000ull + i * 22500) * 1000;
+  for (uint32_t ch = 0; ch < frame.channel_count; ch++) {
+    frame.channels[ch] = 12500 + nextRandom() % 25000;
+  }
+  return frame;
+}
+
+void expectFrame(const CPPMFrame& actual, const CPPMFrame& expected, const char* test_name) {
+  bool equal = actual.time_ns == expected.time_ns &&
+    actual.channel_count == expected.channel_count &&
+    actual.is_error == expected.is_error &&
+    !memcmp(actual.channels, expected.channels, sizeof(actual.channels));
+  if (!equal) {
+    printf("Failure in \"%s\": frame at %llu does not match\n", test_name, (unsigned long long)expected.time_ns);
+    failure_count++;
+  }
+}
+
+void testRoundTrip() {
+  static uint8_t data[CPPMTraceWriter::MAX_HEADER_SIZE + NUM_FRAMES * CPPMTraceWriter::MAX_RECORD_SIZE];
+  static CPPMFrame frames[NUM_FRAMES];
+
+  CPPMTraceWriter writer;
+  size_t size = writer.writeHeader(HEADER, data);
+  for (size_t i = 0; i < NUM_FRAMES; i++) {
+    frames[i] = makeFrame(i);
+    size_t record_size = writer.writeFrame(frames[i], &data[size]);
+    // Drop every 100th frame, as if the ring was full
+    if (i % 100 == 99) {
+      writer.dropFrame();
+    } else {
+      size += record_size;
+    }
+  }
+  printf("Round trip: %.1f bytes per frame\n", size / (double)NUM_FRAMES);
+
+  CPPMTraceReader reader;
+  CPPMTraceHeader header;
+  size_t pos = 0;
+  size_t consumed;
+  if (reader.readHeader(data, size, &consumed, &header) != CPPMTraceReader::Result::OK ||
+    header.expected_channel_count != HEADER.expected_channel_count ||
+    header.max_period_us != HEADER.max_period_us ||
+    header.clocks_per_us != HEADER.clocks_per_us) {
+    printf("Failure in \"round trip\": bad header\n");
+    failure_count++;
+    return;
+  }
+  pos += consumed;
+
+  for (size_t i = 0; i < NUM_FRAMES; i++) {
+    if (i % 100 == 99) {
+      continue;
+    }
+
+    CPPMFrame frame;
+    bool frames_dropped;
+    if (reader.readFrame(&data[pos], size - pos, &consumed, &frame, &frames_dropped) != CPPMTraceReader::Result::OK) {
+      printf("Failure in \"round trip\": could not read frame %d\n", (int)i);
+      failure_count++;
+      return;
+    }
+    pos += consumed;
+
+    expectFrame(frame, frames[i], "round trip");
+    if (frames_dropped != (i % 100 == 0 && i > 0)) {
+      printf("Failure in \"round trip\": frame %d frames_dropped %d\n", (int)i, (int)frames_dropped);
+      failure_count++;
+    }
+  }
+
+  if (pos != size) {
+    printf("Failure in \"round trip\": %d bytes left over\n", (int)(size - pos));
+    failure_count++;
+  }
+}
+
+void testIncomplete() {
+  uint8_t data[CPPMTraceWriter::MAX_HEADER_SIZE + CPPMTraceWriter::MAX_RECORD_SIZE];
+  CPPMTraceWriter writer;
+  size_t header_size = writer.writeHeader(HEADER, data);
+  CPPMFrame expected = makeFrame(0);
+  size_t size = header_size + writer.writeFrame(expected, &data[header_size]);
+
+  CPPMTraceReader reader;
+  CPPMTraceHeader header;
+  size_t consumed;
+  for (size_t i = 0; i < header_size; i++) {
+    if (reader.readHeader(data, i, &consumed, &header) != CPPMTraceReader::Result::INCOMPLETE) {
+      printf("Failure in \"incomplete\": header with %d bytes was not incomplete\n", (int)i);
+      failure_count++;
+    }
+  }
+  reader.readHeader(data, header_size, &consumed, &header);
+
+  CPPMFrame frame;
+  bool frames_dropped;
+  for (size_t i = header_size; i < size; i++) {
+    if (reader.readFrame(&data[header_size], i - header_size, &consumed, &frame, &frames_dropped) !=
+      CPPMTraceReader::Result::INCOMPLETE) {
+      printf("Failure in \"incomplete\": record with %d bytes was not incomplete\n", (int)(i - header_size));
+      failure_count++;
+    }
+  }
+  if (reader.readFrame(&data[header_size], size - header_size, &consumed, &frame, &frames_dropped) !=
+    CPPMTraceReader::Result::OK) {
+    printf("Failure in \"incomplete\": could not read complete record\n");
+    failure_count++;
+  }
+  expectFrame(frame, expected, "incomplete");
+}
+
+void testInvalid() {
+  const uint8_t bad_magic[] = {'P', 'P', 'M', 'c', 1, 9, 0, 0};
+  CPPMTraceReader reader;
+  CPPMTraceHeader header;
+  size_t consumed;
+  if (reader.readHeader(bad_magic, sizeof(bad_magic), &consumed, &header) != CPPMTraceReader::Result::INVALID) {
+    printf("Failure in \"invalid\": bad magic was accepted\n");
+    failure_count++;
+  }
+
+  // Delta-encoded record (no keyframe flag) at the start of a trace
+  const uint8_t no_keyframe[] = {1, 0, 0};
+  CPPMFrame frame;
+  bool frames_dropped;
+  if (reader.readFrame(no_keyframe, sizeof(no_keyframe), &consumed, &frame, &frames_dropped) !=
+    CPPMTraceReader::Result::INVALID) {
+    printf("Failure in \"invalid\": record without keyframe was accepted\n");
+    failure_count++;
+  }
+}
+
+int main() {
+  printf("Begin test\n");
+
+  testRoundTrip();
+  testIncomplete();
+  testInvalid();
+
+  printf("Test complete!\n");
+  return failure_count ? 1 : 0;
+}
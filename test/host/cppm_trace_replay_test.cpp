@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <vector>
+
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace_format.h"
+
+#include "cppm_trace_replay.h"
+
+// Encodes frames, decodes and records them as a trace, then replays the trace and checks that decoding
+// the replayed edges reproduces the recorded frames
+constexpr size_t NUM_FRAMES = 200;
+constexpr CPPMTraceHeader HEADER = {9, 2500, 125};
+constexpr uint64_t SYNC_PERIOD_US = 5000;
+// Periods outside CPPMDecoder's default [1000, 2000] calibration, which must not be clamped by replay
+constexpr double MIN_PERIOD_US = 700;
+constexpr double MAX_PERIOD_US = 2400;
+
+// The decoded period may differ by one decoder count (see CPPMTraceReplay)
+constexpr double EXPECT_DELTA_US = (double)CPPMReferenceDecoder::CLOCKS_PER_COUNT / HEADER.clocks_per_us;
+// Recorded times are rounded to microseconds, and decoded times to a clock cycle
+constexpr uint64_t EXPECT_DELTA_NS = 1000;
+
+int failure_count = 0;
+
+uint32_t random_state = 1;
+
+uint32_t nextRandom() {
+  random_state = random_state * 1103515245 + 12345;
+  return random_state >> 8;
+}
+
+// Decode edges with the header's settings, including the final timeout
+std::vector<CPPMFrame> decode(const std::vector<CPPMEdge>& edges) {
+  CPPMReferenceDecoder decoder(HEADER.expected_channel_count, HEADER.max_period_us, HEADER.clocks_per_us);
+  std::vector<CPPMFrame> frames;
+  CPPMFrame frame;
+  for (const CPPMEdge& edge : edges) {
+    if (decoder.processEdge(edge, &frame)) {
+      frames.push_back(frame);
+    }
+  }
+  if (decoder.processTimeout(edges.back().time_ns + 2 * HEADER.max_period_us * 1000, &frame)) {
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+// Encode frames with random periods, with occasional pauses between them
+std::vector<CPPMEdge> encodeFrames() {
+  CPPMReferenceEncoder encoder(500, 1000, 2000, SYNC_PERIOD_US, HEADER.clocks_per_us);
+  std::vector<CPPMEdge> edges;
+  for (size_t i = 0; i < NUM_FRAMES; i++) {
+    for (uint32_t ch = 0; ch < CPPMReferenceEncoder::NUM_CHANNELS; ch++) {
+      double value_us = MIN_PERIOD_US + nextRandom() % 100000 / 100000.0 * (MAX_PERIOD_US - MIN_PERIOD_US);
+      // Make sure the extremes are covered
+      if (i == 10) {
+        value_us = ch % 2 ? 800 : 2300;
+      }
+      encoder.setChannelUs(ch, value_us);
+    }
+    if (i % 40 == 39) {
+      encoder.reset(encoder.getTimeNs() + 100000 + nextRandom() % 100000);
+    }
+
+    CPPMEdge frame_edges[CPPMReferenceEncoder::EDGES_PER_FRAME];
+    size_t edge_count = encoder.encodeFrame(frame_edges);
+    edges.insert(edges.end(), frame_edges, frame_edges + edge_count);
+  }
+  return edges;
+}
+
+void testReplay() {
+  std::vector<CPPMFrame> recorded = decode(encodeFrames());
+
+  // Record a trace, including an error frame which replay leaves as a gap
+  CPPMFrame error_frame = recorded[20];
+  error_frame.channel_count = 3;
+  error_frame.is_error = true;
+  for (uint32_t ch = 3; ch < CPPMFrame::NUM_CHANNELS; ch++) {
+    error_frame.channels[ch] = 0;
+  }
+  std::vector<uint8_t> data(CPPMTraceWriter::MAX_HEADER_SIZE + (recorded.size() + 1) * CPPMTraceWriter::MAX_RECORD_SIZE);
+  CPPMTraceWriter writer;
+  size_t size = writer.writeHeader(HEADER, data.data());
+  for (size_t i = 0; i < recorded.size(); i++) {
+    if (i == 20) {
+      size += writer.writeFrame(error_frame, &data[size]);
+    }
+    size += writer.writeFrame(recorded[i], &data[size]);
+  }
+
+  // Read the trace back and replay it
+  CPPMTraceReader reader;
+  CPPMTraceHeader header;
+  size_t pos = 0;
+  size_t consumed;
+  if (reader.readHeader(data.data(), size, &consumed, &header) != CPPMTraceReader::Result::OK) {
+    printf("Failure in \"replay\": bad header\n");
+    failure_count++;
+    return;
+  }
+  pos += consumed;
+
+  CPPMTraceReplay replay;
+  if (!replay.begin(header)) {
+    printf("Failure in \"replay\": header was rejected\n");
+    failure_count++;
+    return;
+  }
+  std::vector<CPPMEdge> replayed_edges;
+  while (pos < size) {
+    CPPMFrame frame;
+    bool frames_dropped;
+    if (reader.readFrame(&data[pos], size - pos, &consumed, &frame, &frames_dropped) != CPPMTraceReader::Result::OK) {
+      printf("Failure in \"replay\": could not read frame at %d\n", (int)pos);
+      failure_count++;
+      return;
+    }
+    pos += consumed;
+
+    CPPMEdge edges[CPPMReferenceEncoder::EDGES_PER_FRAME];
+    size_t edge_count = replay.replayFrame(frame, edges);
+    if (frame.is_error && edge_count) {
+      printf("Failure in \"replay\": error frame was replayed\n");
+      failure_count++;
+    }
+    replayed_edges.insert(replayed_edges.end(), edges, edges + edge_count);
+  }
+
+  std::vector<CPPMFrame> replayed = decode(replayed_edges);
+  if (replayed.size() != recorded.size()) {
+    printf("Failure in \"replay\": got %d frames; want %d\n", (int)replayed.size(), (int)recorded.size());
+    failure_count++;
+    return;
+  }
+
+  CPPMReferenceDecoder decoder(HEADER.expected_channel_count, HEADER.max_period_us, HEADER.clocks_per_us);
+  for (size_t i = 0; i < recorded.size(); i++) {
+    if (replayed[i].is_error || replayed[i].channel_count != recorded[i].channel_count) {
+      printf("Failure in \"replay\": frame %d has %d channels; want %d\n",
+        (int)i, replayed[i].channel_count, recorded[i].channel_count);
+      failure_count++;
+    }
+    int64_t time_delta_ns = (int64_t)(replayed[i].time_ns - recorded[i].time_ns);
+    if ((uint64_t)llabs(time_delta_ns) > EXPECT_DELTA_NS) {
+      printf("Failure in \"replay\": frame %d at %llu; want %llu\n",
+        (int)i, (unsigned long long)replayed[i].time_ns, (unsigned long long)recorded[i].time_ns);
+      failure_count++;
+    }
+    for (uint32_t ch = 0; ch < CPPMFrame::NUM_CHANNELS; ch++) {
+      double want = decoder.getChannelUs(recorded[i], ch);
+      double actual = decoder.getChannelUs(replayed[i], ch);
+      if (fabs(actual - want) > EXPECT_DELTA_US + 1e-9) {
+        printf("Failure in \"replay\": frame %d channel %d expected %f; actual %f\n", (int)i, (int)ch, want, actual);
+        failure_count++;
+      }
+    }
+  }
+}
+
+void testChannelCount() {
+  // The reference encoder always sends 9 channels, which a decoder expecting 8 would treat as errors
+  CPPMTraceReplay replay;
+  CPPMTraceHeader header = HEADER;
+  header.expected_channel_count = 8;
+  if (replay.begin(header)) {
+    printf("Failure in \"channel count\": header with 8 expected channels was accepted\n");
+    failure_count++;
+  }
+}
+
+int main() {
+  printf("Begin test\n");
+
+  testReplay();
+  testChannelCount();
+
+  printf("Test complete!\n");
+  return failure_count ? 1 : 0;
+}
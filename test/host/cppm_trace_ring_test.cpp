@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace_format.h"
+#include "pico_cppm/cppm_trace_ring.h"
+
+constexpr CPPMTraceHeader HEADER = {9, 2500, 125};
+
+int failure_count = 0;
+
+uint32_t random_state = 1;
+
+uint32_t nextRandom() {
+  random_state = random_state * 1103515245 + 12345;
+  return random_state >> 8;
+}
+
+CPPMFrame makeFrame(size_t i) {
+  CPPMFrame frame = {};
+  frame.channel_count = (i % 50 == 7) ? 3 : 9;
+  frame.is_error = frame.channel_count != HEADER.expected_channel_count;
+  frame.time_ns = (uint64_t)i * 22500 * 1000;
+  for (uint32_t ch = 0; ch < frame.channel_count; ch++) {
+    frame.channels[ch] = 12500 + nextRandom() % 25000;
+  }
+  return frame;
+}
+
+// Frames which should be found in the trace, and whether each one follows dropped frames
+struct ExpectedTrace {
+  std::vector<CPPMFrame> frames;
+  std::vector<bool> frames_dropped;
+  bool next_frames_dropped = false;
+};
+
+// Append frame to ring, and add it to expected if it was stored. Returns true if it was stored
+bool appendFrame(CPPMTraceRing* ring, const CPPMFrame& frame, ExpectedTrace* expected) {
+  uint32_t dropped_frame_count = ring->getDroppedFrameCount();
+  ring->appendFrame(frame);
+  if (ring->getDroppedFrameCount() != dropped_frame_count) {
+    expected->next_frames_dropped = true;
+    return false;
+  }
+  expected->frames.push_back(frame);
+  expected->frames_dropped.push_back(expected->next_frames_dropped);
+  expected->next_frames_dropped = false;
+  return true;
+}
+
+// Parse data as a complete trace, and compare it with expected
+void expectTrace(const std::vector<uint8_t>& data, const ExpectedTrace& expected, const char* test_name) {
+  CPPMTraceReader reader;
+  CPPMTraceHeader header;
+  size_t pos = 0;
+  size_t consumed;
+  if (reader.readHeader(data.data(), data.size(), &consumed, &header) != CPPMTraceReader::Result::OK ||
+    header.expected_channel_count != HEADER.expected_channel_count ||
+    header.max_period_us != HEADER.max_period_us ||
+    header.clocks_per_us != HEADER.clocks_per_us) {
+    printf("Failure in \"%s\": bad header\n", test_name);
+    failure_count++;
+    return;
+  }
+  pos += consumed;
+
+  for (size_t i = 0; i < expected.frames.size(); i++) {
+    CPPMFrame frame;
+    bool frames_dropped;
+    if (reader.readFrame(&data[pos], data.size() - pos, &consumed, &frame, &frames_dropped) !=
+      CPPMTraceReader::Result::OK) {
+      printf("Failure in \"%s\": could not read frame %d\n", test_name, (int)i);
+      failure_count++;
+      return;
+    }
+    pos += consumed;
+
+    const CPPMFrame& expected_frame = expected.frames[i];
+    bool equal = frame.time_ns == expected_frame.time_ns &&
+      frame.channel_count == expected_frame.channel_count &&
+      frame.is_error == expected_frame.is_error &&
+      !memcmp(frame.channels, expected_frame.channels, sizeof(frame.channels));
+    if (!equal) {
+      printf("Failure in \"%s\": frame %d does not match\n", test_name, (int)i);
+      failure_count++;
+    }
+    if (frames_dropped != expected.frames_dropped[i]) {
+      printf("Failure in \"%s\": frame %d frames_dropped %d\n", test_name, (int)i, (int)frames_dropped);
+      failure_count++;
+    }
+  }
+
+  if (pos != data.size()) {
+    printf("Failure in \"%s\": %d bytes left over\n", test_name, (int)(data.size() - pos));
+    failure_count++;
+  }
+}
+
+// Read everything available from ring onto the end of data
+void readAll(CPPMTraceRing* ring, std::vector<uint8_t>* data) {
+  uint8_t chunk[64];
+  while (uint32_t size = ring->read(chunk, sizeof(chunk))) {
+    data->insert(data->end(), chunk, chunk + size);
+  }
+}
+
+void testDropped() {
+  // Only room for the header and one keyframe
+  static uint8_t buffer[64];
+  CPPMTraceRing ring(buffer, sizeof(buffer));
+  ExpectedTrace expected;
+  std::vector<uint8_t> data;
+
+  ring.begin(HEADER);
+  size_t stored_count = 0;
+  for (size_t i = 0; i < 5; i++) {
+    stored_count += appendFrame(&ring, makeFrame(i), &expected);
+  }
+  if (ring.getDroppedFrameCount() != 5 - stored_count || stored_count == 5) {
+    printf("Failure in \"dropped\": %d frames stored, %d dropped\n",
+      (int)stored_count, (int)ring.getDroppedFrameCount());
+    failure_count++;
+  }
+  if (ring.getAvailable() > sizeof(buffer)) {
+    printf("Failure in \"dropped\": %d bytes available\n", (int)ring.getAvailable());
+    failure_count++;
+  }
+
+  // Once there is room again, the next frame is a keyframe marked as following dropped frames
+  readAll(&ring, &data);
+  if (!appendFrame(&ring, makeFrame(5), &expected) || !expected.frames_dropped.back()) {
+    printf("Failure in \"dropped\": frame after drop was not stored as expected\n");
+    failure_count++;
+  }
+  readAll(&ring, &data);
+
+  expectTrace(data, expected, "dropped");
+}
+
+void testWrap() {
+  // read() in odd sized chunks, so records and reads straddle the end of the ring at different offsets
+  static uint8_t buffer[256];
+  CPPMTraceRing ring(buffer, sizeof(buffer));
+  ExpectedTrace expected;
+  std::vector<uint8_t> data;
+
+  ring.begin(HEADER);
+  for (size_t i = 0; i < 1000; i++) {
+    appendFrame(&ring, makeFrame(i), &expected);
+
+    uint8_t chunk[64];
+    uint32_t size = ring.read(chunk, 1 + nextRandom() % 40);
+    data.insert(data.end(), chunk, chunk + size);
+  }
+  readAll(&ring, &data);
+
+  if (data.size() < 10 * sizeof(buffer) || !ring.getDroppedFrameCount()) {
+    printf("Failure in \"wrap\": %d bytes and %d dropped frames does not cover wrapping and dropping\n",
+      (int)data.size(), (int)ring.getDroppedFrameCount());
+    failure_count++;
+  }
+  expectTrace(data, expected, "wrap");
+}
+
+void testPeek() {
+  // Consume as the UART DMA does: one contiguous transfer at a time, which must not pass the end of the ring
+  static uint8_t buffer[256];
+  CPPMTraceRing ring(buffer, sizeof(buffer));
+  ExpectedTrace expected;
+  std::vector<uint8_t> data;
+  size_t split_count = 0;
+
+  ring.begin(HEADER);
+  for (size_t i = 0; i < 1000; i++) {
+    appendFrame(&ring, makeFrame(i), &expected);
+
+    // Sometimes let the ring fill up, as if the UART was slower than the decoder
+    if (nextRandom() % 4) {
+      continue;
+    }
+    uint32_t available = ring.getAvailable();
+    const uint8_t* transfer;
+    uint32_t size = ring.peek(&transfer);
+    if (transfer < buffer || transfer + size > buffer + sizeof(buffer) || size > available) {
+      printf("Failure in \"peek\": transfer of %d bytes at offset %d is outside the ring\n",
+        (int)size, (int)(transfer - buffer));
+      failure_count++;
+      return;
+    }
+    if (size < available) {
+      split_count++;
+    }
+    data.insert(data.end(), transfer, transfer + size);
+    ring.consume(size);
+  }
+  readAll(&ring, &data);
+
+  if (!split_count) {
+    printf("Failure in \"peek\": no transfers were split at the end of the ring\n");
+    failure_count++;
+  }
+  expectTrace(data, expected, "peek");
+}
+
+void testBegin() {
+  static uint8_t buffer[64];
+  CPPMTraceRing ring(buffer, sizeof(buffer));
+
+  ring.begin(HEADER);
+  for (size_t i = 0; i < 5; i++) {
+    ring.appendFrame(makeFrame(i));
+  }
+  uint8_t chunk[16];
+  ring.read(chunk, sizeof(chunk));
+
+  // Unread data and drop state from the previous trace are discarded
+  ExpectedTrace expected;
+  std::vector<uint8_t> data;
+  ring.begin(HEADER);
+  if (ring.getDroppedFrameCount()) {
+    printf("Failure in \"begin\": dropped frame count was not reset\n");
+    failure_count++;
+  }
+  appendFrame(&ring, makeFrame(5), &expected);
+  readAll(&ring, &data);
+
+  expectTrace(data, expected, "begin");
+}
+
+int main() {
+  printf("Begin test\n");
+
+  testDropped();
+  testWrap();
+  testPeek();
+  testBegin();
+
+  printf("Test complete!\n");
+  return failure_count ? 1 : 0;
+}
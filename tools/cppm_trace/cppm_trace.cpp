@@ -0,0 +1,153 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace_format.h"
+
+#include "cppm_trace_replay.h"
+
+// Converts traces recorded by CPPMTrace to CSV, or replays them through CPPMReferenceEncoder
+
+constexpr size_t READ_BUFFER_SIZE = 64 * 1024;
+
+void printUsage() {
+  fprintf(stderr,
+    "Usage:\n"
+    "  cppm_trace csv <trace file>     Print one CSV row per frame\n"
+    "  cppm_trace replay <trace file>  Replay valid frames through the reference encoder at their recorded\n"
+    "                                  times, printing edges as CSV\n");
+}
+
+// Read the trace from file, calling handle_header once and then handle_frame for each frame. Returns false
+// if the trace is invalid, or handle_header returns false
+template <typename HeaderHandler, typename FrameHandler>
+bool readTrace(FILE* file, HeaderHandler handle_header, FrameHandler handle_frame) {
+  static uint8_t data[READ_BUFFER_SIZE];
+  size_t size = 0;
+  size_t pos = 0;
+  bool has_header = false;
+
+  CPPMTraceReader reader;
+  CPPMTraceHeader header;
+  // Used for the same channel period conversion as CPPMDecoder, once the header is known
+  CPPMReferenceDecoder decoder;
+
+  while (true) {
+    CPPMTraceReader::Result result;
+    size_t consumed;
+    if (!has_header) {
+      result = reader.readHeader(&data[pos], size - pos, &consumed, &header);
+      if (result == CPPMTraceReader::Result::OK) {
+        has_header = true;
+        decoder = CPPMReferenceDecoder(header.expected_channel_count, header.max_period_us, header.clocks_per_us);
+        if (!handle_header(header)) {
+          return false;
+        }
+      }
+    } else {
+      CPPMFrame frame;
+      bool frames_dropped;
+      result = reader.readFrame(&data[pos], size - pos, &consumed, &frame, &frames_dropped);
+      if (result == CPPMTraceReader::Result::OK) {
+        handle_frame(decoder, frame, frames_dropped);
+      }
+    }
+
+    if (result == CPPMTraceReader::Result::OK) {
+      pos += consumed;
+      continue;
+    }
+    if (result == CPPMTraceReader::Result::INVALID) {
+      fprintf(stderr, "Invalid trace data\n");
+      return false;
+    }
+
+    // Shift unread data to the start of the buffer and refill
+    memmove(data, &data[pos], size - pos);
+    size -= pos;
+    pos = 0;
+    size_t read_size = fread(&data[size], 1, sizeof(data) - size, file);
+    size += read_size;
+
+    if (!read_size) {
+      if (!has_header) {
+        fprintf(stderr, "Missing header\n");
+        return false;
+      }
+      // Incomplete data at the end of a trace is expected if recording was interrupted
+      if (size) {
+        fprintf(stderr, "Ignoring %zu bytes of incomplete data at end of trace\n", size);
+      }
+      return true;
+    }
+  }
+}
+
+bool printCSV(FILE* file) {
+  printf("time_us,channel_count,is_error,frames_dropped");
+  for (uint32_t ch = 0; ch < CPPMFrame::NUM_CHANNELS; ch++) {
+    printf(",ch%" PRIu32 "_us", ch);
+  }
+  printf("\n");
+
+  return readTrace(file, [](const CPPMTraceHeader& /*header*/) { return true; },
+    [](const CPPMReferenceDecoder& decoder, const CPPMFrame& frame, bool frames_dropped) {
+    printf("%" PRIu64 ",%d,%d,%d", frame.time_ns / 1000, frame.channel_count, frame.is_error, frames_dropped);
+    for (uint32_t ch = 0; ch < CPPMFrame::NUM_CHANNELS; ch++) {
+      if (frame.channels[ch]) {
+        printf(",%.2f", decoder.getChannelUs(frame, ch));
+      } else {
+        printf(",");
+      }
+    }
+    printf("\n");
+  });
+}
+
+bool printReplay(FILE* file) {
+  printf("time_ns,level\n");
+
+  CPPMTraceReplay replay;
+  return readTrace(file, [&](const CPPMTraceHeader& header) {
+    if (!replay.begin(header)) {
+      fprintf(stderr, "Can't replay a trace with %d expected channels, the reference encoder sends %" PRIu32 "\n",
+        header.expected_channel_count, CPPMReferenceEncoder::NUM_CHANNELS);
+      return false;
+    }
+    return true;
+  }, [&](const CPPMReferenceDecoder& /*decoder*/, const CPPMFrame& frame, bool /*frames_dropped*/) {
+    CPPMEdge edges[CPPMReferenceEncoder::EDGES_PER_FRAME];
+    size_t edge_count = replay.replayFrame(frame, edges);
+    for (size_t i = 0; i < edge_count; i++) {
+      printf("%" PRIu64 ",%d\n", edges[i].time_ns, edges[i].level);
+    }
+  });
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    printUsage();
+    return 1;
+  }
+
+  bool (*command)(FILE*) = nullptr;
+  if (!strcmp(argv[1], "csv")) {
+    command = printCSV;
+  } else if (!strcmp(argv[1], "replay")) {
+    command = printReplay;
+  } else {
+    printUsage();
+    return 1;
+  }
+
+  FILE* file = fopen(argv[2], "rb");
+  if (!file) {
+    fprintf(stderr, "Could not open %s\n", argv[2]);
+    return 1;
+  }
+
+  bool ok = command(file);
+  fclose(file);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#include "cppm_trace_replay.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace_format.h"
+
+bool CPPMTraceReplay::begin(const CPPMTraceHeader& header) {
+  if (header.expected_channel_count != CPPMReferenceEncoder::NUM_CHANNELS) {
+    return false;
+  }
+
+  max_period_ns = (uint64_t)header.max_period_us * NANOS_PER_MICRO;
+  decoder = CPPMReferenceDecoder(header.expected_channel_count, header.max_period_us, header.clocks_per_us);
+  // Channel periods are set directly, so the min/max only set the initial values. The sync period is
+  // replaced by the gap before the next frame
+  encoder = CPPMReferenceEncoder(PULSE_US, 0, header.max_period_us, header.max_period_us, header.clocks_per_us);
+  min_start_ns = 0;
+  return true;
+}
+
+size_t CPPMTraceReplay::replayFrame(const CPPMFrame& frame, CPPMEdge* edges) {
+  if (frame.is_error) {
+    return 0;
+  }
+
+  for (uint32_t ch = 0; ch < CPPMReferenceEncoder::NUM_CHANNELS; ch++) {
+    double value_us = decoder.getChannelUs(frame, ch);
+    // Missing channels are left at their previous value
+    if (!value_us) {
+      continue;
+    }
+    encoder.setChannelUs(ch, value_us);
+  }
+
+  encoder.reset();
+  size_t edge_count = encoder.encodeFrame(edges);
+
+  // A valid frame is recorded when the decoder times out, max period after the sync pulse starts.
+  // Place the sync pulse accordingly, so that decoding the output reproduces the recorded times
+  uint64_t sync_pulse_ns = edges[edge_count - 2].time_ns;
+  uint64_t start_ns = min_start_ns;
+  if (frame.time_ns > max_period_ns + sync_pulse_ns + start_ns) {
+    start_ns = frame.time_ns - max_period_ns - sync_pulse_ns;
+  }
+  min_start_ns = start_ns + sync_pulse_ns + max_period_ns + (uint64_t)(PULSE_US * NANOS_PER_MICRO);
+
+  for (size_t i = 0; i < edge_count; i++) {
+    edges[i].time_ns += start_ns;
+  }
+  return edge_count;
+}
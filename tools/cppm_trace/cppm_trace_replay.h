@@ -0,0 +1,40 @@
+#ifndef __PICO_CPPM_TOOLS_CPPM_TRACE_CPPM_TRACE_REPLAY_H__
+#define __PICO_CPPM_TOOLS_CPPM_TRACE_CPPM_TRACE_REPLAY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico_cppm/cppm_reference.h"
+#include "pico_cppm/cppm_trace_format.h"
+
+// Replays frames from a trace through CPPMReferenceEncoder. Channel periods are reproduced as recorded
+// (rather than through [-1, 1] values), and each frame is placed so that decoding the edges with the
+// header's settings finishes it at its recorded time, as long as frames are far enough apart.
+//
+// The encoder's 2 clock resolution and the decoder's sampling mean a decoded period may differ from the
+// recorded one by up to one decoder count (CLOCKS_PER_COUNT clocks), as with CPPMEncoder and CPPMDecoder
+class CPPMTraceReplay {
+ public:
+  static constexpr double PULSE_US = 500;
+
+  // Start replaying a trace with header. Returns false if the trace can't be replayed, because
+  // expected_channel_count doesn't match the channels sent by CPPMReferenceEncoder
+  bool begin(const CPPMTraceHeader& header);
+
+  // Write the edges for frame to edges (at least CPPMReferenceEncoder::EDGES_PER_FRAME entries), returns
+  // the number of edges written. Like CPPMDecoder, error frames do not update channel values, so they
+  // (and dropped frames) are left as gaps with no edges
+  size_t replayFrame(const CPPMFrame& frame, CPPMEdge* edges);
+
+ private:
+  static constexpr uint64_t NANOS_PER_MICRO = 1'000;
+
+  uint64_t max_period_ns = 0;
+  // Used for the same channel period conversion as CPPMDecoder
+  CPPMReferenceDecoder decoder;
+  CPPMReferenceEncoder encoder;
+  // Earliest start of the next frame, which leaves a long enough sync period after the previous one
+  uint64_t min_start_ns = 0;
+};
+
+#endif